@@ -0,0 +1,204 @@
+#include "corpus.h"
+
+#include <cstdio>
+
+/**
+ * Size of the generated documents in millimeters.
+ */
+constexpr double kDocumentSize = 200;
+
+double BenchRandom::uniform(double min, double max) {
+    // xorshift64*
+    state_ ^= state_ >> 12;
+    state_ ^= state_ << 25;
+    state_ ^= state_ >> 27;
+    std::uint64_t bits = (state_ * 0x2545f4914f6cdd1dull) >> 11;
+    return min + (max - min) * static_cast<double>(bits) /
+                     static_cast<double>(1ull << 53);
+}
+
+/**
+ * Appends a number with a fixed precision.
+ */
+void append_number(std::string& svg, double value) {
+    char number[32];
+    std::snprintf(number, sizeof(number), "%.3f", value);
+    svg += number;
+}
+
+void append_point(std::string& svg, double x, double y) {
+    append_number(svg, x);
+    svg += ',';
+    append_number(svg, y);
+    svg += ' ';
+}
+
+std::string document_start() {
+    std::string svg =
+        R"(<?xml version="1.0" encoding="UTF-8"?>)"
+        "\n"
+        R"(<svg xmlns="http://www.w3.org/2000/svg" width="200mm" )"
+        R"(height="200mm" viewBox="0 0 200 200">)"
+        "\n";
+    return svg;
+}
+
+/**
+ * Appends groups of closed paths made of cubic curves.
+ */
+void append_curves(std::string& svg, BenchRandom& random, std::size_t groups,
+                   std::size_t paths_per_group, std::size_t curves_per_path) {
+    for (std::size_t group = 0; group < groups; group++) {
+        svg += "<g transform=\"rotate(";
+        append_number(svg, random.uniform(-10, 10));
+        svg += ' ';
+        append_point(svg, kDocumentSize / 2, kDocumentSize / 2);
+        svg += ")\">\n";
+        for (std::size_t path = 0; path < paths_per_group; path++) {
+            double x = random.uniform(10, kDocumentSize - 10);
+            double y = random.uniform(10, kDocumentSize - 10);
+            svg += R"(<path d="M )";
+            append_point(svg, x, y);
+            for (std::size_t curve = 0; curve < curves_per_path; curve++) {
+                svg += "C ";
+                for (int point = 0; point < 3; point++) {
+                    append_point(svg, x + random.uniform(-8, 8),
+                                 y + random.uniform(-8, 8));
+                }
+            }
+
+            svg += R"(Z"/>)";
+            svg += "\n";
+        }
+
+        svg += "</g>\n";
+    }
+}
+
+/**
+ * Appends circles, ellipses and rectangles with dashed strokes.
+ */
+void append_dashed(std::string& svg, BenchRandom& random,
+                   std::size_t shapes) {
+    for (std::size_t shape = 0; shape < shapes; shape++) {
+        double x = random.uniform(10, kDocumentSize - 10);
+        double y = random.uniform(10, kDocumentSize - 10);
+        switch (shape % 3) {
+            case 0:
+                svg += R"(<circle cx=")";
+                append_number(svg, x);
+                svg += R"(" cy=")";
+                append_number(svg, y);
+                svg += R"(" r=")";
+                append_number(svg, random.uniform(2, 10));
+                break;
+            case 1:
+                svg += R"(<ellipse cx=")";
+                append_number(svg, x);
+                svg += R"(" cy=")";
+                append_number(svg, y);
+                svg += R"(" rx=")";
+                append_number(svg, random.uniform(2, 10));
+                svg += R"(" ry=")";
+                append_number(svg, random.uniform(2, 10));
+                break;
+            default:
+                svg += R"(<rect x=")";
+                append_number(svg, x - 5);
+                svg += R"(" y=")";
+                append_number(svg, y - 5);
+                svg += R"(" width=")";
+                append_number(svg, random.uniform(2, 10));
+                svg += R"(" height=")";
+                append_number(svg, random.uniform(2, 10));
+                svg += R"(" rx="1)";
+                break;
+        }
+
+        svg += R"(" stroke-dasharray="1.5 0.5 0.2 0.5"/>)";
+        svg += "\n";
+    }
+}
+
+/**
+ * Appends the definitions of the patterns "lines" and "circles".
+ */
+void append_pattern_definitions(std::string& svg) {
+    svg +=
+        "<defs>\n"
+        R"(<pattern id="lines" width="4" height="4" )"
+        "patternUnits=\"userSpaceOnUse\" patternTransform=\"rotate(30)\">"
+        "\n"
+        R"(<line x1="0" y1="0" x2="4" y2="4"/>)"
+        R"(<line x1="0" y1="2" x2="4" y2="2"/>)"
+        "\n</pattern>\n"
+        R"(<pattern id="circles" width="0.1" height="0.1" )"
+        R"(viewBox="0 0 10 10">)"
+        "\n"
+        R"(<circle cx="5" cy="5" r="3"/>)"
+        R"(<path d="M 0 0 C 3 4 7 6 10 10" stroke-dasharray="1 1"/>)"
+        "\n</pattern>\n</defs>\n";
+}
+
+/**
+ * Appends large circles and curved paths filled with the patterns.
+ */
+void append_pattern_fills(std::string& svg, BenchRandom& random,
+                          std::size_t shapes) {
+    for (std::size_t shape = 0; shape < shapes; shape++) {
+        const char* pattern = shape % 2 == 0 ? "lines" : "circles";
+        double x = random.uniform(30, kDocumentSize - 30);
+        double y = random.uniform(30, kDocumentSize - 30);
+        if (shape % 4 < 2) {
+            svg += R"(<circle cx=")";
+            append_number(svg, x);
+            svg += R"(" cy=")";
+            append_number(svg, y);
+            svg += R"(" r=")";
+            append_number(svg, random.uniform(10, 25));
+        } else {
+            svg += R"(<path d="M )";
+            append_point(svg, x - 20, y);
+            svg += "C ";
+            append_point(svg, x - 20, y - 30);
+            append_point(svg, x + 20, y - 30);
+            append_point(svg, x + 20, y);
+            svg += "S ";
+            append_point(svg, x - 10, y + 10);
+            append_point(svg, x - 20, y);
+            svg += 'Z';
+        }
+
+        svg += R"(" fill="url(#)";
+        svg += pattern;
+        svg += ")\"/>";
+        svg += "\n";
+    }
+}
+
+std::vector<CorpusDocument> generate_corpus() {
+    std::vector<CorpusDocument> corpus;
+    BenchRandom random{0x5eed};
+
+    std::string curves = document_start();
+    append_curves(curves, random, 20, 100, 8);
+    corpus.push_back(CorpusDocument{"curves", curves + "</svg>\n"});
+
+    std::string dashed = document_start();
+    append_dashed(dashed, random, 1500);
+    corpus.push_back(CorpusDocument{"dashed", dashed + "</svg>\n"});
+
+    std::string patterns = document_start();
+    append_pattern_definitions(patterns);
+    append_pattern_fills(patterns, random, 16);
+    corpus.push_back(CorpusDocument{"patterns", patterns + "</svg>\n"});
+
+    std::string mixed = document_start();
+    append_pattern_definitions(mixed);
+    append_curves(mixed, random, 5, 100, 8);
+    append_dashed(mixed, random, 400);
+    append_pattern_fills(mixed, random, 4);
+    corpus.push_back(CorpusDocument{"mixed", mixed + "</svg>\n"});
+
+    return corpus;
+}
@@ -0,0 +1,43 @@
+#ifndef SVG_CONVERTER_BENCH_CORPUS_H_
+#define SVG_CONVERTER_BENCH_CORPUS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Deterministic pseudo random numbers.
+ *
+ * Unlike the standard distributions, the sequence is the same with every
+ * standard library, so inputs are identical wherever the benchmarks run.
+ */
+class BenchRandom {
+ private:
+    std::uint64_t state_;
+
+ public:
+    explicit BenchRandom(std::uint64_t seed) : state_{seed | 1} {}
+
+    /**
+     * Uniformly distributed number in `[min, max)`.
+     */
+    double uniform(double min, double max);
+};
+
+struct CorpusDocument {
+    std::string name;
+    std::string svg;
+};
+
+/**
+ * Generates the documents converted by the macro benchmarks.
+ *
+ * Each stresses another part of the conversion:
+ *  - "curves": Many paths of cubic curves in nested, transformed groups.
+ *  - "dashed": Basic shapes with dashed strokes.
+ *  - "patterns": Large shapes filled with patterns of lines and circles.
+ *  - "mixed": All of the above in a single document.
+ */
+std::vector<CorpusDocument> generate_corpus();
+
+#endif  // SVG_CONVERTER_BENCH_CORPUS_H_
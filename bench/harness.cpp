@@ -0,0 +1,103 @@
+#include "harness.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+#include <utility>
+
+#include "stats.h"
+#include "transform_points.h"
+
+/**
+ * Receives the items of every iteration, so that the compiler can't drop
+ * the work producing them.
+ */
+volatile std::size_t benchmark_sink = 0;
+
+void BenchmarkRegistry::add(std::string name, std::string group,
+                            std::string item_unit,
+                            BenchmarkFunction function) {
+    benchmarks_.push_back(Benchmark{std::move(name), std::move(group),
+                                    std::move(item_unit),
+                                    std::move(function)});
+}
+
+BenchmarkResult run_benchmark(const Benchmark& benchmark,
+                              const BenchmarkOptions& options) {
+    // The warm up also measures how many iterations fill the minimum time
+    auto warm_up_start = std::chrono::steady_clock::now();
+    std::size_t items = benchmark.function();
+    auto warm_up_time = std::chrono::steady_clock::now() - warm_up_start;
+    benchmark_sink = benchmark_sink + items;
+
+    auto min_time =
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            options.min_time);
+    std::size_t iterations = 1;
+    if (warm_up_time.count() > 0 && warm_up_time < min_time) {
+        iterations = static_cast<std::size_t>(min_time / warm_up_time) + 1;
+    }
+
+    BenchmarkResult result{benchmark.name, benchmark.group,
+                           benchmark.item_unit, iterations, items, {}};
+    for (unsigned repetition = 0; repetition < options.repetitions;
+         repetition++) {
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < iterations; i++) {
+            benchmark_sink = benchmark_sink + benchmark.function();
+        }
+
+        std::chrono::duration<double, std::nano> time =
+            std::chrono::steady_clock::now() - start;
+        result.times.push_back(time.count() / static_cast<double>(iterations));
+    }
+
+    return result;
+}
+
+/**
+ * Writes a number with a fixed precision, to keep the output diffable.
+ */
+void write_number(std::ostream& out, double value) {
+    char number[32];
+    std::snprintf(number, sizeof(number), "%.1f", value);
+    out << number;
+}
+
+void write_results_json(std::ostream& out,
+                        const std::vector<BenchmarkResult>& results,
+                        const BenchmarkOptions& options) {
+    // Names and units are fixed identifiers, so no escaping is needed
+    out << "{\"context\":{\"stats\":"
+        << (SVG_CONVERTER_STATS ? "true" : "false")
+        << ",\"transform_kernel\":\""
+        << transform_kernel_name(transform_kernel())
+        << "\",\"min_time_ms\":" << options.min_time.count()
+        << ",\"repetitions\":" << options.repetitions << "},\"benchmarks\":[";
+    for (std::size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult& result = results[i];
+        std::vector<double> times = result.times;
+        std::sort(times.begin(), times.end());
+        double median = times[times.size() / 2];
+        double mean = std::accumulate(times.begin(), times.end(), 0.0) /
+                      static_cast<double>(times.size());
+
+        out << (i > 0 ? "," : "") << "\n{\"name\":\"" << result.name
+            << "\",\"group\":\"" << result.group
+            << "\",\"iterations\":" << result.iterations
+            << ",\"min_ns\":";
+        write_number(out, times.front());
+        out << ",\"median_ns\":";
+        write_number(out, median);
+        out << ",\"mean_ns\":";
+        write_number(out, mean);
+        out << ",\"items_per_iteration\":" << result.items_per_iteration
+            << ",\"item_unit\":\"" << result.item_unit
+            << "\",\"items_per_second\":";
+        write_number(out, static_cast<double>(result.items_per_iteration) /
+                              median * 1e9);
+        out << '}';
+    }
+
+    out << "\n]}\n";
+}
@@ -0,0 +1,106 @@
+#ifndef SVG_CONVERTER_BENCH_HARNESS_H_
+#define SVG_CONVERTER_BENCH_HARNESS_H_
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Runs one iteration of a benchmark.
+ *
+ * @return Number of items processed, like points or bytes written. Reported
+ *         as a rate and folded into a checksum, so the work can't be
+ *         optimised away.
+ */
+using BenchmarkFunction = std::function<std::size_t()>;
+
+struct Benchmark {
+    std::string name;
+
+    /**
+     * Either "micro" or "macro".
+     */
+    std::string group;
+
+    /**
+     * Unit of the items returned by `function`.
+     */
+    std::string item_unit;
+    BenchmarkFunction function;
+};
+
+/**
+ * Collects the benchmarks to run.
+ *
+ * Inputs are built when a benchmark is registered and shared with its
+ * function, so their construction is not measured.
+ */
+class BenchmarkRegistry {
+ private:
+    std::vector<Benchmark> benchmarks_;
+
+ public:
+    void add(std::string name, std::string group, std::string item_unit,
+             BenchmarkFunction function);
+
+    const std::vector<Benchmark>& benchmarks() const { return benchmarks_; }
+};
+
+struct BenchmarkOptions {
+    /**
+     * Minimum time of each repetition, the number of iterations is chosen to
+     * reach it.
+     */
+    std::chrono::milliseconds min_time{200};
+    unsigned repetitions = 5;
+
+    /**
+     * Only benchmarks whose name contains this are run.
+     */
+    std::string filter;
+};
+
+struct BenchmarkResult {
+    std::string name;
+    std::string group;
+    std::string item_unit;
+    std::size_t iterations;
+    std::size_t items_per_iteration;
+
+    /**
+     * Nanoseconds per iteration of each repetition.
+     */
+    std::vector<double> times;
+};
+
+/**
+ * Runs a benchmark after a warm up iteration.
+ */
+BenchmarkResult run_benchmark(const Benchmark& benchmark,
+                              const BenchmarkOptions& options);
+
+/**
+ * Writes results as a single JSON object, followed by a newline.
+ *
+ * Each benchmark reports the minimum, median and mean time per iteration in
+ * nanoseconds, and the items per second of the median. The minimum is the
+ * most stable across runs and should be used to compare commits.
+ */
+void write_results_json(std::ostream& out,
+                        const std::vector<BenchmarkResult>& results,
+                        const BenchmarkOptions& options);
+
+/**
+ * Registers the benchmarks of single functions on synthetic inputs.
+ */
+void add_micro_benchmarks(BenchmarkRegistry& registry);
+
+/**
+ * Registers the benchmarks converting generated documents end to end.
+ */
+void add_macro_benchmarks(BenchmarkRegistry& registry);
+
+#endif  // SVG_CONVERTER_BENCH_HARNESS_H_
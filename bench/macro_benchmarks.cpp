@@ -0,0 +1,53 @@
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <spdlog/sinks/null_sink.h>
+#include <spdlog/spdlog.h>
+
+#include "conversion.h"
+#include "corpus.h"
+#include "harness.h"
+#include "output_sink.h"
+#include "svg.h"
+
+/**
+ * Registers a benchmark parsing and converting a document, like the
+ * converter does for a file.
+ */
+void add_convert(BenchmarkRegistry& registry, const std::string& name,
+                 std::shared_ptr<const std::string> svg,
+                 const ConversionOptions& options,
+                 std::shared_ptr<spdlog::logger> logger) {
+    registry.add(name, "macro", "bytes", [=]() {
+        SvgDocument document{svg->data(), svg->size()};
+        OutputSink sink{
+            [](const char* /*unused*/, std::size_t /*unused*/) {}};
+        convert(document, *logger, sink, options);
+        return sink.bytes_written();
+    });
+}
+
+void add_macro_benchmarks(BenchmarkRegistry& registry) {
+    // Warnings about the documents would only distort the timing
+    auto logger = std::make_shared<spdlog::logger>(
+        "bench", std::make_shared<spdlog::sinks::null_sink_st>());
+
+    std::shared_ptr<const std::string> mixed;
+    for (auto& document : generate_corpus()) {
+        auto svg = std::make_shared<const std::string>(std::move(document.svg));
+        add_convert(registry, "convert_" + document.name, svg, {}, logger);
+        if (document.name == "mixed") {
+            mixed = svg;
+        }
+    }
+
+    // The optional passes over the output. The budget is never reached, so
+    // the time measures the reordering instead of the budget.
+    ConversionOptions options;
+    options.simplify = true;
+    options.optimize_travel = true;
+    options.travel_time_budget = std::chrono::minutes{1};
+    add_convert(registry, "convert_mixed_simplify_optimize_travel", mixed,
+                options, logger);
+}
@@ -0,0 +1,101 @@
+#include <getopt.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <libxml/parser.h>
+
+#include "harness.h"
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << R"(
+Runs the micro and macro benchmarks and writes the results as JSON to stdout.
+
+Options:
+  --filter TEXT        Only run benchmarks whose name contains TEXT.
+  --min-time MS        Minimum time of each repetition in milliseconds
+                       (default: 200).
+  --repetitions N      Number of repetitions of each benchmark (default: 5).
+  --output FILE        Write the results to FILE instead of stdout.
+)";
+}
+
+int main(int argc, char* argv[]) {
+    enum Option { kFilter, kMinTime, kRepetitions, kOutput };
+    const option long_options[] = {
+        {"filter", required_argument, nullptr, kFilter},
+        {"min-time", required_argument, nullptr, kMinTime},
+        {"repetitions", required_argument, nullptr, kRepetitions},
+        {"output", required_argument, nullptr, kOutput},
+        {nullptr, 0, nullptr, 0}};
+
+    BenchmarkOptions options;
+    std::string output_filename;
+    bool valid = true;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+        switch (opt) {
+            case kFilter:
+                options.filter = optarg;
+                break;
+            case kMinTime:
+                options.min_time = std::chrono::milliseconds{
+                    std::strtol(optarg, nullptr, 10)};
+                valid = valid && options.min_time.count() >= 0;
+                break;
+            case kRepetitions:
+                options.repetitions =
+                    static_cast<unsigned>(std::strtoul(optarg, nullptr, 10));
+                valid = valid && options.repetitions > 0;
+                break;
+            case kOutput:
+                output_filename = optarg;
+                break;
+            default:
+                valid = false;
+                break;
+        }
+    }
+
+    if (!valid || optind != argc) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    LIBXML_TEST_VERSION
+
+    BenchmarkRegistry registry;
+    add_micro_benchmarks(registry);
+    add_macro_benchmarks(registry);
+
+    std::vector<BenchmarkResult> results;
+    for (const auto& benchmark : registry.benchmarks()) {
+        if (benchmark.name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+
+        // Progress goes to stderr, so stdout only contains the results
+        std::cerr << benchmark.name << "..." << std::endl;
+        results.push_back(run_benchmark(benchmark, options));
+    }
+
+    if (output_filename.empty()) {
+        write_results_json(std::cout, results, options);
+        return 0;
+    }
+
+    std::ofstream out{output_filename};
+    write_results_json(out, results, options);
+    out.close();
+    if (!out) {
+        std::cerr << "Failed to write results to " << output_filename << '\n';
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,231 @@
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "bezier.h"
+#include "corpus.h"
+#include "harness.h"
+#include "math_defs.h"
+#include "output_sink.h"
+#include "parsing/context/pattern.h"
+#include "parsing/dashes.h"
+#include "parsing/gpgl_exporter.h"
+#include "parsing/path.h"
+
+/**
+ * Seed of the inputs, fixed so that all runs measure the same work.
+ */
+constexpr std::uint64_t kMicroBenchmarkSeed = 0xbe7c4;
+
+/**
+ * Factor for the control points of a quarter circle approximated by a
+ * cubic curve.
+ */
+constexpr double kCircleKappa = 0.5522847498;
+
+/**
+ * Closed path of random cubic curves within a square around a center.
+ */
+Path random_curve_path(BenchRandom& random, const Vector& center,
+                       double radius, std::size_t curves) {
+    auto random_point = [&]() {
+        return Vector{center(0) + random.uniform(-radius, radius),
+                      center(1) + random.uniform(-radius, radius)};
+    };
+
+    Path path;
+    path.reserve(curves + 2, 3 * curves + 1);
+    path.push_command(MoveCommand{random_point()});
+    for (std::size_t i = 0; i < curves; i++) {
+        Vector ctrl1 = random_point();
+        Vector ctrl2 = random_point();
+        path.push_command(BezierCommand{random_point(), ctrl1, ctrl2});
+    }
+
+    path.push_command(CloseSubpathCommand{});
+    return path;
+}
+
+/**
+ * Circle made of four cubic curves, like SVG++ generates for `<circle>`.
+ */
+Path circle_path(const Vector& center, double radius) {
+    Path path;
+    double control = kCircleKappa * radius;
+    path.push_command(MoveCommand{center + Vector{radius, 0}});
+    path.push_command(BezierCommand{center + Vector{0, radius},
+                                    center + Vector{radius, control},
+                                    center + Vector{control, radius}});
+    path.push_command(BezierCommand{center + Vector{-radius, 0},
+                                    center + Vector{-control, radius},
+                                    center + Vector{-radius, control}});
+    path.push_command(BezierCommand{center + Vector{0, -radius},
+                                    center + Vector{-radius, -control},
+                                    center + Vector{-control, -radius}});
+    path.push_command(BezierCommand{center + Vector{radius, 0},
+                                    center + Vector{control, -radius},
+                                    center + Vector{radius, -control}});
+    path.push_command(CloseSubpathCommand{});
+    return path;
+}
+
+void add_subdivide_curve(BenchmarkRegistry& registry,
+                         const FlatteningTolerance& tolerance) {
+    BenchRandom random{kMicroBenchmarkSeed};
+    auto curves = std::make_shared<std::vector<Vector>>();
+    for (int i = 0; i < 4 * 1000; i++) {
+        curves->emplace_back(random.uniform(0, 20), random.uniform(0, 20));
+    }
+
+    registry.add("subdivide_curve", "micro", "points", [=]() {
+        std::size_t points = 0;
+        const std::vector<Vector>& c = *curves;
+        for (std::size_t i = 0; i < c.size(); i += 4) {
+            subdivide_curve(tolerance, c[i], c[i + 1], c[i + 2], c[i + 3],
+                            [&points](const Vector& /*unused*/) { points++; });
+        }
+
+        return points;
+    });
+}
+
+void add_dashifying_polyline_visitor(BenchmarkRegistry& registry) {
+    struct Input {
+        std::vector<Vector> polyline;
+        std::vector<double> dasharray{1.5, 0.5, 0.2, 0.5};
+        Transform to_local = Transform::Identity();
+    };
+
+    // A random walk with steps in the range of flattened curve segments
+    BenchRandom random{kMicroBenchmarkSeed};
+    auto input = std::make_shared<Input>();
+    Vector point{0, 0};
+    for (int i = 0; i < 10000; i++) {
+        point += Vector{random.uniform(-0.5, 0.5), random.uniform(-0.5, 0.5)};
+        input->polyline.push_back(point);
+    }
+
+    registry.add("dashifying_polyline_visitor", "micro", "points", [=]() {
+        std::size_t points = 0;
+        auto factory = [&points](const Vector& /*unused*/) {
+            return [&points](const Vector& /*unused*/) { points++; };
+        };
+
+        const std::vector<Vector>& polyline = input->polyline;
+        detail::DashifyingPolylineVisitor<decltype(factory)&> visitor{
+            factory, input->to_local, polyline.front(), input->dasharray};
+        for (std::size_t i = 1; i < polyline.size(); i++) {
+            visitor(polyline[i]);
+        }
+
+        return points;
+    });
+}
+
+void add_path_transform(BenchmarkRegistry& registry) {
+    constexpr std::size_t kCurves = 1000;
+    BenchRandom random{kMicroBenchmarkSeed};
+    auto path = std::make_shared<Path>(
+        random_curve_path(random, Vector{100, 100}, 50, kCurves));
+
+    // A rotation around the center keeps the points in place over many
+    // iterations and takes the general affine path
+    auto rotation = std::make_shared<Transform>(
+        Eigen::Translation2d{100, 100} * Eigen::Rotation2Dd{0.01} *
+        Eigen::Translation2d{-100, -100});
+
+    registry.add("path_transform", "micro", "points", [=]() {
+        path->transform(*rotation);
+        return 3 * kCurves + 1;
+    });
+}
+
+/**
+ * Input of the tiling and clipping benchmarks: A pattern of two lines,
+ * rotated like `patternTransform="rotate(30)"`, filling a large circle.
+ */
+struct TiledPatternInput {
+    Vector pattern_size{4, 4};
+    Transform to_root;
+    Rect content_bounds;
+    Path clipping_path = circle_path(Vector{100, 100}, 40);
+    std::vector<DashedPath> pattern_paths;
+    std::vector<detail::PatternTile> tiles;
+
+    explicit TiledPatternInput(const FlatteningTolerance& tolerance) {
+        to_root = Eigen::Rotation2Dd{std::acos(-1.0) / 6};
+        pattern_paths.emplace_back(line_path(Vector{0, 0}, Vector{4, 4}));
+        pattern_paths.emplace_back(line_path(Vector{0, 2}, Vector{4, 2}));
+        content_bounds = detail::pattern_content_bounds(pattern_paths);
+        tiles = detail::compute_tiling(pattern_size, to_root, content_bounds,
+                                       clipping_path, tolerance);
+    }
+
+    /**
+     * Line from one point to another, transformed to the root coordinate
+     * system like the pattern exporter does.
+     */
+    Path line_path(const Vector& from, const Vector& to) const {
+        Path path;
+        path.push_command(MoveCommand{from});
+        path.push_command(LineCommand{to});
+        path.transform(to_root);
+        return path;
+    }
+};
+
+void add_tiled_pattern(BenchmarkRegistry& registry,
+                       const FlatteningTolerance& tolerance) {
+    auto input = std::make_shared<TiledPatternInput>(tolerance);
+
+    registry.add("compute_tiling", "micro", "tiles", [=]() {
+        return detail::compute_tiling(input->pattern_size, input->to_root,
+                                      input->content_bounds,
+                                      input->clipping_path, tolerance)
+            .size();
+    });
+
+    registry.add("clip_tiled_pattern", "micro", "points", [=]() {
+        ClipperLib::Paths paths = detail::clip_tiled_pattern(
+            input->clipping_path, input->pattern_paths, input->tiles,
+            tolerance, 1);
+        std::size_t points = 0;
+        for (const auto& path : paths) {
+            points += path.size();
+        }
+
+        return points;
+    });
+}
+
+void add_gpgl_exporter_plot(BenchmarkRegistry& registry,
+                            const FlatteningTolerance& tolerance) {
+    struct Input {
+        OutputSink sink{[](const char* /*unused*/, std::size_t /*unused*/) {}};
+        GpglWriter writer{sink};
+        DashedPath path;
+
+        explicit Input(Path outline) : path{std::move(outline)} {}
+    };
+
+    BenchRandom random{kMicroBenchmarkSeed};
+    auto input = std::make_shared<Input>(
+        random_curve_path(random, Vector{100, 100}, 50, 1000));
+
+    registry.add("gpgl_exporter_plot", "micro", "bytes", [=]() {
+        std::size_t bytes_before = input->sink.bytes_written();
+        GpglExporter{input->writer, tolerance}.plot(input->path);
+        return input->sink.bytes_written() - bytes_before;
+    });
+}
+
+void add_micro_benchmarks(BenchmarkRegistry& registry) {
+    // The tolerance of the default quality
+    FlatteningTolerance tolerance = gpgl_flattening_tolerance(1);
+
+    add_subdivide_curve(registry, tolerance);
+    add_dashifying_polyline_visitor(registry);
+    add_path_transform(registry);
+    add_tiled_pattern(registry, tolerance);
+    add_gpgl_exporter_plot(registry, tolerance);
+}
@@ -1,6 +1,4 @@
 #!/bin/bash
-for IN_FILE in /convert/*.svg; do
-    OUT_FILE="${IN_FILE%.svg}.gpgl"
-    ERR_FILE="${IN_FILE%.svg}.err"
-    /build/svg_converter $IN_FILE > $OUT_FILE 2> $ERR_FILE
-done
+# Converts all files in a single process, writing a .gpgl and .err file next
+# to each input.
+/build/svg_converter --batch /convert
@@ -0,0 +1,4 @@
+#!/bin/bash
+# Converts the SVG read from stdin and writes the GPGL program to stdout,
+# without touching the convert directory.
+docker run --rm -i -v $(realpath build):/build linespace-svg-converter /build/svg_converter "$@" -
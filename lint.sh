@@ -1,2 +1,2 @@
 #!/bin/sh
-cpplint --recursive --quiet --verbose=0 src
+cpplint --recursive --quiet --verbose=0 src bench test
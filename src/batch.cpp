@@ -0,0 +1,283 @@
+#include "batch.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <iostream>
+#include <memory>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+
+#include "conversion.h"
+#include "logging.h"
+#include "output_sink.h"
+#include "svg.h"
+#include "svg_stream.h"
+#include "thread_pool.h"
+
+/**
+ * Extensions of plain and compressed SVG files.
+ */
+constexpr std::array<const char*, 2> kSvgExtensions{{".svg", ".svgz"}};
+
+bool ends_with(const std::string& str, const std::string& suffix) {
+    return str.size() >= suffix.size() &&
+           str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool has_svg_extension(const std::string& filename) {
+    for (const char* svg_extension : kSvgExtensions) {
+        if (ends_with(filename, svg_extension)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Replaces the `.svg` or `.svgz` extension of a filename (if any) with
+ * another one.
+ */
+std::string replace_svg_extension(const std::string& filename,
+                                  const std::string& extension) {
+    std::string base = filename;
+    for (const char* svg_extension : kSvgExtensions) {
+        if (ends_with(base, svg_extension)) {
+            base.resize(base.size() - std::string{svg_extension}.size());
+            break;
+        }
+    }
+
+    return base + extension;
+}
+
+bool is_directory(const std::string& path) {
+    struct stat info {};
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+void read_manifest(std::istream& manifest, std::vector<std::string>& files) {
+    std::string line;
+    while (std::getline(manifest, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+
+        if (!line.empty()) {
+            files.push_back(line);
+        }
+    }
+}
+
+/**
+ * Adds all (possibly compressed) SVG files directly inside a directory,
+ * sorted by name.
+ *
+ * @return Whether the directory could be read.
+ */
+bool list_directory(const std::string& directory,
+                    std::vector<std::string>& files) {
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        return false;
+    }
+
+    std::vector<std::string> names;
+    while (const dirent* entry = readdir(dir)) {
+        std::string name{static_cast<const char*>(entry->d_name)};
+        if (has_svg_extension(name)) {
+            names.push_back(std::move(name));
+        }
+    }
+
+    closedir(dir);
+
+    std::sort(names.begin(), names.end());
+    for (const auto& name : names) {
+        files.push_back(directory + '/' + name);
+    }
+
+    return true;
+}
+
+/**
+ * Adds all files matching a glob pattern.
+ *
+ * @return Whether any file matched.
+ */
+bool expand_glob(const std::string& pattern, std::vector<std::string>& files) {
+    glob_t glob_result{};
+    bool matched = glob(pattern.c_str(), 0, nullptr, &glob_result) == 0;
+    if (matched) {
+        for (std::size_t i = 0; i < glob_result.gl_pathc; i++) {
+            files.emplace_back(glob_result.gl_pathv[i]);  // NOLINT
+        }
+    }
+
+    globfree(&glob_result);
+    return matched;
+}
+
+/**
+ * Converts a single file, see `convert_batch`.
+ */
+bool convert_file(const std::string& input, const ConversionOptions& options) {
+    std::unique_ptr<spdlog::logger> logger;
+    try {
+        logger =
+            create_file_logger(input, replace_svg_extension(input, ".err"));
+    } catch (const spdlog::spdlog_ex& err) {
+        get_global_logger().error("{}: Failed to open error log: {}", input,
+                                  err.what());
+        return false;
+    }
+
+    int fd = -1;
+    try {
+        std::unique_ptr<SvgDocument> doc;
+        std::unique_ptr<SvgStream> stream;
+        if (options.stream) {
+            stream = std::make_unique<SvgStream>(input);
+        } else {
+            doc = std::make_unique<SvgDocument>(input);
+        }
+
+        std::string output = replace_svg_extension(input, ".gpgl");
+        fd = open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                  0666);  // NOLINT
+        if (fd < 0) {
+            throw std::system_error{errno, std::generic_category(),
+                                    "Failed to open output file"};
+        }
+
+        // Nobody reads the output while it is being generated, so we only
+        // write full buffers.
+        OutputSink sink{fd_write_function(fd)};
+        if (stream) {
+            convert(*stream, *logger, sink, options);
+        } else {
+            convert(*doc, *logger, sink, options);
+        }
+        if (close(fd) != 0) {
+            fd = -1;
+            throw std::system_error{errno, std::generic_category(),
+                                    "Failed to close output file"};
+        }
+
+        return true;
+    } catch (const SvgLoadError& err) {
+        logger->critical("Failed to load svg: {}", err.what());
+    } catch (const std::system_error& err) {
+        logger->critical("{}", err.what());
+    } catch (const std::exception& err) {
+        // Anything else, like running out of memory or a failure in the
+        // clipping library, only fails this file instead of the whole batch
+        logger->critical("Failed to convert svg: {}", err.what());
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    return false;
+}
+
+std::vector<std::string> expand_batch_inputs(
+    const std::vector<std::string>& inputs, spdlog::logger& logger) {
+    std::vector<std::string> files;
+    for (const auto& input : inputs) {
+        if (input == "-") {
+            read_manifest(std::cin, files);
+        } else if (is_directory(input)) {
+            if (!list_directory(input, files)) {
+                logger.error("Failed to read directory {}", input);
+            }
+        } else if (!expand_glob(input, files)) {
+            logger.error("No files match {}", input);
+        }
+    }
+
+    return files;
+}
+
+/**
+ * Finds the files whose outputs would also be written for another file, like
+ * for `a.svg` and `a.svgz`, or a file that is listed twice.
+ *
+ * @return For each file, whether its outputs clash with another file's.
+ */
+std::vector<bool> find_output_clashes(const std::vector<std::string>& files,
+                                      spdlog::logger& logger) {
+    std::vector<bool> clashes(files.size(), false);
+    std::unordered_map<std::string, std::size_t> first_files;
+    for (std::size_t index = 0; index < files.size(); index++) {
+        std::string output = replace_svg_extension(files[index], ".gpgl");
+        auto inserted = first_files.emplace(output, index);
+        if (!inserted.second) {
+            std::size_t first = inserted.first->second;
+            logger.error("{}: Output file {} would also be written for {}",
+                         files[index], output, files[first]);
+            clashes[first] = true;
+            clashes[index] = true;
+        }
+    }
+
+    return clashes;
+}
+
+std::vector<BatchFileResult> convert_batch(
+    const std::vector<std::string>& files, unsigned num_threads,
+    const ConversionOptions& options) {
+    // Workers converting two such files would write the same output files at
+    // the same time, so neither of them is converted
+    const std::vector<bool> clashes =
+        find_output_clashes(files, get_global_logger());
+
+    std::vector<BatchFileResult> results(files.size());
+    parallel_for(files.size(), num_threads, [&](std::size_t index) {
+        auto start_time = std::chrono::steady_clock::now();
+        const Stats stats_before = current_thread_stats();
+        BatchFileResult& result = results[index];
+        result.input = files[index];
+        result.success =
+            !clashes[index] && convert_file(files[index], options);
+        result.duration = std::chrono::steady_clock::now() - start_time;
+        result.stats = current_thread_stats() - stats_before;
+    });
+
+    return results;
+}
+
+void log_batch_summary(const std::vector<BatchFileResult>& results,
+                       std::chrono::steady_clock::duration total_duration,
+                       spdlog::logger& logger) {
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+
+    std::size_t failed = 0;
+    Milliseconds cpu_time{0};
+    for (const auto& result : results) {
+        Milliseconds duration = result.duration;
+        cpu_time += duration;
+        if (result.success) {
+            logger.info("{}: ok ({:.1f} ms)", result.input, duration.count());
+        } else {
+            failed++;
+            logger.error("{}: failed ({:.1f} ms)", result.input,
+                         duration.count());
+        }
+    }
+
+    logger.info(
+        "Converted {} files ({} failed) in {:.1f} ms, {:.1f} ms summed over "
+        "all files",
+        results.size(), failed, Milliseconds{total_duration}.count(),
+        cpu_time.count());
+}
@@ -0,0 +1,77 @@
+#ifndef SVG_CONVERTER_BATCH_H_
+#define SVG_CONVERTER_BATCH_H_
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "conversion.h"
+#include "stats.h"
+
+/**
+ * Outcome of converting a single file in batch mode.
+ */
+struct BatchFileResult {
+    /**
+     * Filename of the converted SVG file.
+     */
+    std::string input;
+
+    /**
+     * Whether the file could be loaded and the output could be written.
+     *
+     * Problems inside the document are only reported in the `.err` file and
+     * don't make a conversion unsuccessful, same as for a single conversion.
+     */
+    bool success = false;
+
+    /**
+     * Wall clock time spent on the file, including loading and writing.
+     */
+    std::chrono::steady_clock::duration duration{};
+
+    /**
+     * Counters and phase times of the conversion.
+     */
+    Stats stats;
+};
+
+/**
+ * Expands the inputs passed on the command line to a list of SVG files.
+ *
+ * Each input can be
+ *  - `-`, to read a manifest with one filename per line from stdin,
+ *  - a directory, to convert all `.svg` and `.svgz` files directly inside
+ *    of it,
+ *  - a glob pattern (which includes plain filenames).
+ *
+ * Inputs that don't match any file are reported to the logger.
+ */
+std::vector<std::string> expand_batch_inputs(
+    const std::vector<std::string>& inputs, spdlog::logger& logger);
+
+/**
+ * Converts all given files using a pool of worker threads.
+ *
+ * For each file, the GPGL program is written to a `.gpgl` file and all
+ * messages to a `.err` file next to it. Both replace the `.svg` or `.svgz`
+ * extension of the input file. Files that would share their output files
+ * with another one, like `a.svg` and `a.svgz`, are not converted and
+ * count as failed.
+ *
+ * @return Results in the same order as `files`.
+ */
+std::vector<BatchFileResult> convert_batch(
+    const std::vector<std::string>& files, unsigned num_threads,
+    const ConversionOptions& options);
+
+/**
+ * Logs the per file timings and totals of a batch conversion.
+ */
+void log_batch_summary(const std::vector<BatchFileResult>& results,
+                       std::chrono::steady_clock::duration total_duration,
+                       spdlog::logger& logger);
+
+#endif  // SVG_CONVERTER_BATCH_H_
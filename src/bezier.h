@@ -1,47 +1,214 @@
 #ifndef SVG_CONVERTER_BEZIER_H_
 #define SVG_CONVERTER_BEZIER_H_
 
-#include <eigen3/Eigen/Geometry>
-
-#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 
 #include "math_defs.h"
 
+/**
+ * Upper bound for the number of segments a single curve is flattened into.
+ *
+ * Guards against runaway subdivision for huge curves or tiny thresholds.
+ */
+constexpr std::size_t kMaxCurveSegments = 1 << 16;
+
+/**
+ * Describes how exactly curves are approximated by polylines.
+ */
+struct FlatteningTolerance {
+    /**
+     * Maximum distance between a curve and its polyline.
+     *
+     * Only guaranteed down to the minimum segment length: if that is larger,
+     * the distance is bounded by the minimum segment length instead.
+     */
+    double max_error;
+
+    /**
+     * Length below which segments are not worth generating.
+     *
+     * Usually the resolution of the output device. A curve is not split
+     * into more segments than this length fits into its control polygon,
+     * unless fewer segments would deviate from the curve by more than this
+     * length.
+     */
+    double min_segment_length;
+};
+
+/**
+ * Number of straight segments needed to approximate a curve.
+ *
+ * Computed up front with Wang's formula: if a cubic bezier curve is evaluated
+ * at `n` uniformly spaced parameter values, the polyline through these points
+ * deviates from the curve by at most `3/4 * M / n^2`, where `M` is the largest
+ * norm of the second differences of the control points. We choose the
+ * smallest `n` for which this is within the maximum error.
+ *
+ * The segment count is limited so that segments are on average not shorter
+ * than the minimum segment length, which a device with that resolution
+ * couldn't draw anyway. Short average segments don't mean short segments
+ * everywhere though: where the parameter speed is uneven (clustered control
+ * points, cusps), the long segments can still deviate a lot. So the limit is
+ * never lower than the count for which Wang's bound is within the minimum
+ * segment length.
+ *
+ * Degenerate curves (all points equal) need a single segment. Curves with
+ * non finite control points are replaced by a single segment as well, instead
+ * of trying to subdivide them.
+ *
+ * @return Number of segments, between 1 and `kMaxCurveSegments`.
+ */
+inline std::size_t curve_segment_count(const FlatteningTolerance& tolerance,
+                                       const Vector& start, const Vector& ctrl1,
+                                       const Vector& ctrl2, const Vector& end) {
+    double max_second_difference =
+        std::max((start - 2 * ctrl1 + ctrl2).norm(),
+                 (ctrl1 - 2 * ctrl2 + end).norm());
+    double polygon_length =
+        (ctrl1 - start).norm() + (ctrl2 - ctrl1).norm() + (end - ctrl2).norm();
+    if (!std::isfinite(max_second_difference) ||
+        !std::isfinite(polygon_length)) {
+        return 1;
+    }
+
+    double error_segments = std::ceil(
+        std::sqrt(0.75 * max_second_difference / tolerance.max_error));
+    double resolution_segments = std::max(
+        std::ceil(polygon_length / tolerance.min_segment_length),
+        std::ceil(std::sqrt(0.75 * max_second_difference /
+                            tolerance.min_segment_length)));
+    double segments = std::min(error_segments, resolution_segments);
+    // The negated comparison also catches NaN, which results from a zero
+    // tolerance for a degenerate curve.
+    if (!(segments <= static_cast<double>(kMaxCurveSegments))) {
+        return max_second_difference == 0 ? 1 : kMaxCurveSegments;
+    }
+
+    return std::max<std::size_t>(1, static_cast<std::size_t>(segments));
+}
+
+/**
+ * Evaluates a curve at `segment_count` uniformly spaced parameter values.
+ *
+ * Uses forward differencing, so each point only costs a few additions. The
+ * callback is called with a `Vector` argument for each point, excluding the
+ * start point. The last point is always exactly `end`.
+ */
+template <class Callback>
+void flatten_curve(std::size_t segment_count, const Vector& start,
+                   const Vector& ctrl1, const Vector& ctrl2, const Vector& end,
+                   Callback callback) {
+    // Polynomial coefficients of the curve, B(t) = a t^3 + b t^2 + c t + start
+    Vector a = 3 * (ctrl1 - ctrl2) + end - start;
+    Vector b = 3 * (start - 2 * ctrl1 + ctrl2);
+    Vector c = 3 * (ctrl1 - start);
+
+    double step = 1.0 / static_cast<double>(segment_count);
+    double step2 = step * step;
+    double step3 = step2 * step;
+
+    Vector point = start;
+    Vector delta1 = a * step3 + b * step2 + c * step;
+    Vector delta2 = 6 * a * step3 + 2 * b * step2;
+    Vector delta3 = 6 * a * step3;
+
+    for (std::size_t i = 1; i < segment_count; i++) {
+        point += delta1;
+        delta1 += delta2;
+        delta2 += delta3;
+        callback(point);
+    }
+
+    callback(end);
+}
+
+/**
+ * Like `flatten_curve`, but writes the points to a caller provided buffer.
+ *
+ * @param out Output iterator (or pointer to a buffer) that can take
+ *            `segment_count` points.
+ * @return Iterator past the last written point.
+ */
+template <class OutputIterator>
+OutputIterator flatten_curve_into(std::size_t segment_count,
+                                  const Vector& start, const Vector& ctrl1,
+                                  const Vector& ctrl2, const Vector& end,
+                                  OutputIterator out) {
+    flatten_curve(segment_count, start, ctrl1, ctrl2, end,
+                  [&out](const Vector& point) { *out++ = point; });
+    return out;
+}
+
+/**
+ * Exact bounding box of a curve.
+ *
+ * Besides the end points, a cubic can only reach its extremes where its
+ * derivative vanishes. Per axis that's a root of the quadratic
+ * `B'(t) / 3 = a t^2 + b t + c`, of which at most two lie inside (0, 1).
+ */
+inline Rect curve_bounds(const Vector& start, const Vector& ctrl1,
+                         const Vector& ctrl2, const Vector& end) {
+    Rect bounds{start};
+    bounds.extend(end);
+    Vector a = 3 * (ctrl1 - ctrl2) + end - start;
+    Vector b = 2 * (start - 2 * ctrl1 + ctrl2);
+    Vector c = ctrl1 - start;
+
+    auto extend_at = [&](double t) {
+        if (t > 0 && t < 1) {
+            double s = 1 - t;
+            bounds.extend(s * s * s * start + 3 * s * s * t * ctrl1 +
+                          3 * s * t * t * ctrl2 + t * t * t * end);
+        }
+    };
+
+    for (Eigen::Index axis = 0; axis < 2; axis++) {
+        // Control points inside the box of the end points can't leave it
+        if (bounds.min()(axis) <= std::min(ctrl1(axis), ctrl2(axis)) &&
+            std::max(ctrl1(axis), ctrl2(axis)) <= bounds.max()(axis)) {
+            continue;
+        }
+
+        if (std::abs(a(axis)) < 1e-12 * std::abs(b(axis))) {
+            // Quadratic derivative degenerates to a linear one
+            if (b(axis) != 0) {
+                extend_at(-c(axis) / b(axis));
+            }
+            continue;
+        }
+
+        double discriminant = b(axis) * b(axis) - 4 * a(axis) * c(axis);
+        if (discriminant < 0) {
+            continue;
+        }
+
+        double root = std::sqrt(discriminant);
+        extend_at((-b(axis) + root) / (2 * a(axis)));
+        extend_at((-b(axis) - root) / (2 * a(axis)));
+    }
+
+    return bounds;
+}
+
 /**
  * Subdivide the curve to create a polyline.
  *
- * We subdivide the curve until the error threshold is reached, at which point
- * we replace the subcurve by a straight line. As an error metric we use the
- * sum of the distances of both control points from the straight line between
- * the start and end point, as described in
- * http://www.antigrain.com/research/adaptive_bezier/index.html.
+ * The polyline deviates from the curve by at most the maximum error of the
+ * tolerance, unless that would require segments shorter than its minimum
+ * segment length. See `curve_segment_count` for how the subdivision is chosen.
  *
  * The callback is called with a `Point` argument for each point in the
  * generated polyline (from start to back, excluding the start point).
  */
 template <class Callback>
-void subdivide_curve(double error_threshold, const Vector& start,
+void subdivide_curve(const FlatteningTolerance& tolerance, const Vector& start,
                      const Vector& ctrl1, const Vector& ctrl2,
                      const Vector& end, Callback callback) {
-    using Line = Eigen::ParametrizedLine<double, 2>;
-
-    Line straight_line{start, end - start};
-    double error =
-        straight_line.distance(ctrl1) + straight_line.distance(ctrl2);
-    if (error > error_threshold) {
-        // De Casteljau subdivision
-        Vector mid12 = (start + ctrl1) / 2;
-        Vector mid23 = (ctrl1 + ctrl2) / 2;
-        Vector mid34 = (ctrl2 + end) / 2;
-        Vector mid123 = (mid12 + mid23) / 2;
-        Vector mid234 = (mid23 + mid34) / 2;
-        Vector mid1234 = (mid123 + mid234) / 2;
-        subdivide_curve(error_threshold, start, mid12, mid123, mid1234,
-                        callback);
-        subdivide_curve(error_threshold, mid1234, mid234, mid34, end, callback);
-    } else {
-        callback(end);
-    }
+    std::size_t segment_count =
+        curve_segment_count(tolerance, start, ctrl1, ctrl2, end);
+    flatten_curve(segment_count, start, ctrl1, ctrl2, end, callback);
 }
 
 #endif  // SVG_CONVERTER_BEZIER_H_
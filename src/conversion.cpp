@@ -1,33 +1,112 @@
 #include "conversion.h"
 
-#include <sstream>
+#include <functional>
+#include <memory>
 
-#include "logging.h"
 #include "parsing/context/g.h"
 #include "parsing/context/pattern.h"
 #include "parsing/context/shape.h"
 #include "parsing/context/svg.h"
 #include "parsing/gpgl_exporter.h"
 #include "parsing/path.h"
+#include "parsing/pattern_cache.h"
 #include "parsing/traversal.h"
+#include "pen_travel.h"
+#include "stats.h"
+#include "transform_points.h"
 
-std::string convert(const SvgDocument& svg_document) {
+using TraverseFunction = SvgStream::TraverseFunction;
+
+/**
+ * Sets up the conversion pipeline and lets `load` pass (possibly partial)
+ * documents through it.
+ */
+void convert_with(spdlog::logger& logger, OutputSink& sink,
+                  const ConversionOptions& options,
+                  const std::function<void(const TraverseFunction&)>& load) {
     constexpr double print_area_width = 210;
     constexpr double print_area_height = 280;
 
-    std::ostringstream code_stream;
-    spdlog::logger& logger = get_global_logger();
-    GpglExporter exporter{code_stream};
+    FlatteningTolerance tolerance =
+        gpgl_flattening_tolerance(options.tolerance);
+    boost::optional<double> simplify_tolerance;
+    if (options.simplify) {
+        simplify_tolerance = options.simplify_tolerance;
+    }
+
+    GpglWriter writer{sink, simplify_tolerance};
+    std::unique_ptr<PenTravelOptimizer> optimizer;
+    if (options.optimize_travel) {
+        PenTravelOptions travel_options;
+        travel_options.time_budget = options.travel_time_budget;
+        optimizer = std::make_unique<PenTravelOptimizer>(
+            [&writer](const Polyline& polyline) {
+                writer.write_polyline(polyline);
+            },
+            travel_options);
+    }
+
+    GpglExporter exporter{writer, tolerance, optimizer.get()};
     const Viewport global_viewport{print_area_width, print_area_height};
-    SvgContext<GpglExporter> context{svg_document, logger, exporter,
-                                     global_viewport};
-    xmlNodePtr root = svg_document.root();
+    PatternCache pattern_cache;
 
     try {
-        DocumentTraversal::load_document(root, context);
+        load([&](const SvgDocument& document, xmlNodePtr root) {
+            SvgContext<GpglExporter> context{document, logger, exporter,
+                                             global_viewport, pattern_cache,
+                                             tolerance, options.threads};
+            ScopedPhase phase{StatsPhase::kTraversal};
+            DocumentTraversal::load_document(root, context);
+        });
     } catch (const InvalidPathError& err) {
         logger.critical("Invalid SVG: {}", err.what());
+    } catch (const SvgLoadError&) {
+        // Pass on the shapes converted before a streamed document turned out
+        // to be malformed, the sink doesn't flush on destruction
+        if (optimizer) {
+            optimizer->flush();
+        }
+
+        sink.flush();
+        throw;
+    }
+
+    if (optimizer) {
+        optimizer->flush();
+        logger.debug(
+            "Pen-up travel of {} polylines reduced from {:.0f} to {:.0f} units",
+            optimizer->emitted_count(), optimizer->pen_up_distance_before(),
+            optimizer->pen_up_distance_after());
+    }
+
+    logger.debug("Transformed points with the {} kernel",
+                 transform_kernel_name(transform_kernel()));
+    logger.debug("Pattern cache: {} hits, {} misses", pattern_cache.hits(),
+                 pattern_cache.misses());
+    if (options.simplify) {
+        logger.debug("Simplification removed {} of {} commands",
+                     writer.eliminated_command_count(),
+                     writer.command_count());
     }
 
-    return code_stream.str();
+    sink.flush();
+}
+
+void convert(const SvgDocument& svg_document, spdlog::logger& logger,
+             OutputSink& sink, const ConversionOptions& options) {
+    convert_with(logger, sink, options,
+                 [&svg_document](const TraverseFunction& traverse) {
+                     traverse(svg_document, svg_document.root());
+                 });
+}
+
+void convert(SvgStream& svg_stream, spdlog::logger& logger, OutputSink& sink,
+             const ConversionOptions& options) {
+    convert_with(logger, sink, options,
+                 [&svg_stream, &logger](const TraverseFunction& traverse) {
+                     SvgStreamStats stats = svg_stream.read(traverse);
+                     logger.debug(
+                         "Streamed document in {} passes, {} shapes deferred",
+                         stats.passes, stats.deferred_shapes);
+                 });
 }
@@ -1,10 +1,110 @@
 #ifndef SVG_CONVERTER_CONVERSION_H_
 #define SVG_CONVERTER_CONVERSION_H_
 
-#include <string>
+#include <chrono>
 
+#include <spdlog/spdlog.h>
+
+#include "output_sink.h"
 #include "svg.h"
+#include "svg_stream.h"
+
+/**
+ * Presets for the accuracy of curves in the output.
+ */
+enum class Quality { kDraft, kNormal, kFine };
+
+/**
+ * Curve tolerance in GPGL units (1/20 mm) for a quality preset.
+ *
+ * Tolerances below one unit are only met where that doesn't take segments
+ * shorter than one unit, otherwise curves deviate by up to one unit (see
+ * `FlatteningTolerance`).
+ */
+constexpr double quality_tolerance(Quality quality) {
+    switch (quality) {
+        case Quality::kDraft:
+            return 4;
+        case Quality::kNormal:
+            return 1;
+        case Quality::kFine:
+            return 0.5;
+    }
+
+    return 1;
+}
+
+/**
+ * Options influencing the generated output.
+ */
+struct ConversionOptions {
+    /**
+     * Maximum distance between curves and the generated lines in GPGL units.
+     *
+     * Values below half a unit have the same effect as half a unit, because
+     * a finer approximation cannot change the output.
+     */
+    double tolerance = quality_tolerance(Quality::kNormal);
+
+    /**
+     * Whether to drop redundant commands after rounding to GPGL units.
+     */
+    bool simplify = false;
+
+    /**
+     * Maximum distance of merged points from a simplified line in GPGL units.
+     */
+    double simplify_tolerance = 0.5;
+
+    /**
+     * Whether to reorder and reverse polylines to reduce pen-up travel.
+     */
+    bool optimize_travel = false;
+
+    /**
+     * Time that may be spent on reordering polylines per document.
+     */
+    std::chrono::milliseconds travel_time_budget{250};
+
+    /**
+     * Number of threads to use for clipping patterns.
+     *
+     * Doesn't affect the output.
+     */
+    unsigned threads = 1;
+
+    /**
+     * Whether to read documents with `SvgStream` instead of loading them
+     * completely.
+     *
+     * Doesn't affect the output, except for the order of shapes that
+     * reference patterns defined after them.
+     */
+    bool stream = false;
+};
+
+/**
+ * Convert an SVG document into a GPGL program.
+ *
+ * The program is written to the sink while the document is being converted,
+ * and the sink is flushed at the end.
+ *
+ * @param logger Logger to report all problems with the document to.
+ */
+void convert(const SvgDocument& svg_document, spdlog::logger& logger,
+             OutputSink& sink, const ConversionOptions& options = {});
 
-std::string convert(const SvgDocument& svg_document);
+/**
+ * Convert a streamed SVG document into a GPGL program.
+ *
+ * Shapes are converted in batches while the document is being read, see
+ * `SvgStream`.
+ *
+ * @throws SvgLoadError If the document is malformed. Shapes before the error
+ *                      have already been written to the sink, and the sink
+ *                      has been flushed.
+ */
+void convert(SvgStream& svg_stream, spdlog::logger& logger, OutputSink& sink,
+             const ConversionOptions& options = {});
 
 #endif  // SVG_CONVERTER_CONVERSION_H_
@@ -0,0 +1,100 @@
+#include "element_filter.h"
+
+#include <libxml/SAX2.h>
+
+#include <array>
+
+/**
+ * Namespace of SVG elements.
+ */
+constexpr const char* kSvgNamespace = "http://www.w3.org/2000/svg";
+
+/**
+ * SVG elements that are never drawn and can't be referenced by anything that
+ * is drawn.
+ */
+constexpr std::array<const char*, 8> kUnusedSvgElements{
+    {"desc", "foreignObject", "image", "metadata", "script", "style", "text",
+     "title"}};
+
+bool is_unused_element(const xmlChar* local_name,
+                       const xmlChar* namespace_uri) {
+    if (namespace_uri != nullptr &&
+        !xmlStrEqual(namespace_uri, BAD_CAST kSvgNamespace)) {  // NOLINT
+        return true;
+    }
+
+    for (const char* name : kUnusedSvgElements) {
+        if (xmlStrEqual(local_name, BAD_CAST name)) {  // NOLINT
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void SaxElementFilter::install(xmlParserCtxtPtr context) {
+    xmlSAXHandlerPtr handler = context->sax;
+    start_element_ = handler->startElementNs;
+    end_element_ = handler->endElementNs;
+    handler->startElementNs = &SaxElementFilter::start_element;
+    handler->endElementNs = &SaxElementFilter::end_element;
+
+    // Entity references would otherwise end up in the nearest kept ancestor
+    // of a dropped element
+    if (handler->reference != nullptr) {
+        reference_ = handler->reference;
+        handler->reference = &SaxElementFilter::reference;
+    }
+
+    // Nothing reads text, so it's not even passed on
+    handler->characters = nullptr;
+    handler->cdataBlock = nullptr;
+    handler->ignorableWhitespace = nullptr;
+    handler->comment = nullptr;
+    handler->processingInstruction = nullptr;
+
+    context->_private = this;
+}
+
+void SaxElementFilter::start_element(void* context, const xmlChar* local_name,
+                                     const xmlChar* prefix, const xmlChar* uri,
+                                     int namespace_count,
+                                     const xmlChar** namespaces,
+                                     int attribute_count, int defaulted_count,
+                                     const xmlChar** attributes) {
+    auto* filter = static_cast<SaxElementFilter*>(
+        static_cast<xmlParserCtxtPtr>(context)->_private);
+    filter->depth_++;
+    if (filter->skip_depth_ == 0 && filter->depth_ > 1 &&
+        is_unused_element(local_name, uri)) {
+        filter->skip_depth_ = filter->depth_;
+    }
+
+    if (filter->skip_depth_ == 0) {
+        filter->start_element_(context, local_name, prefix, uri,
+                               namespace_count, namespaces, attribute_count,
+                               defaulted_count, attributes);
+    }
+}
+
+void SaxElementFilter::end_element(void* context, const xmlChar* local_name,
+                                   const xmlChar* prefix, const xmlChar* uri) {
+    auto* filter = static_cast<SaxElementFilter*>(
+        static_cast<xmlParserCtxtPtr>(context)->_private);
+    if (filter->skip_depth_ == 0) {
+        filter->end_element_(context, local_name, prefix, uri);
+    } else if (filter->skip_depth_ == filter->depth_) {
+        filter->skip_depth_ = 0;
+    }
+
+    filter->depth_--;
+}
+
+void SaxElementFilter::reference(void* context, const xmlChar* name) {
+    auto* filter = static_cast<SaxElementFilter*>(
+        static_cast<xmlParserCtxtPtr>(context)->_private);
+    if (filter->skip_depth_ == 0) {
+        filter->reference_(context, name);
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef SVG_CONVERTER_ELEMENT_FILTER_H_
+#define SVG_CONVERTER_ELEMENT_FILTER_H_
+
+#include <libxml/parser.h>
+
+#include <cstddef>
+
+/**
+ * Whether an element (including its subtree) is of no use for the conversion.
+ *
+ * True for SVG elements that are neither drawn nor can be referenced by
+ * anything `DocumentTraversal` processes (like `<metadata>`, `<text>` or
+ * `<image>`), and for elements from foreign namespaces (like `sodipodi:` or
+ * `inkscape:` elements written by drawing tools). Everything that might be
+ * referenced by id, like `<pattern>`s, is kept.
+ *
+ * @param local_name Name of the element without namespace prefix.
+ * @param namespace_uri Namespace of the element, null if it has none.
+ */
+bool is_unused_element(const xmlChar* local_name,
+                       const xmlChar* namespace_uri);
+
+/**
+ * Drops unused content from a document while it is being parsed.
+ *
+ * Wraps the SAX handlers of a parser context, so that unused elements (see
+ * `is_unused_element`) and their subtrees, as well as text, comments and
+ * processing instructions, never become part of the DOM. Drawing tools embed
+ * megabytes of metadata and base64 encoded images, which would otherwise be
+ * built into a tree only to be ignored. The root element is always kept.
+ */
+class SaxElementFilter {
+ private:
+    startElementNsSAX2Func start_element_ = nullptr;
+    endElementNsSAX2Func end_element_ = nullptr;
+    referenceSAXFunc reference_ = nullptr;
+
+    /**
+     * Depth of the current element, 1 for the root element.
+     */
+    std::size_t depth_ = 0;
+
+    /**
+     * Depth of the dropped element the parser currently is in, 0 if none.
+     */
+    std::size_t skip_depth_ = 0;
+
+    static void start_element(void* context, const xmlChar* local_name,
+                              const xmlChar* prefix, const xmlChar* uri,
+                              int namespace_count, const xmlChar** namespaces,
+                              int attribute_count, int defaulted_count,
+                              const xmlChar** attributes);
+
+    static void end_element(void* context, const xmlChar* local_name,
+                            const xmlChar* prefix, const xmlChar* uri);
+
+    static void reference(void* context, const xmlChar* name);
+
+ public:
+    SaxElementFilter() = default;
+
+    SaxElementFilter(const SaxElementFilter&) = delete;
+    SaxElementFilter& operator=(const SaxElementFilter&) = delete;
+
+    /**
+     * Installs the filter on a parser context that builds a tree.
+     *
+     * Must be called after the parser options have been set, because setting
+     * them replaces some of the handlers. The filter must stay valid until
+     * parsing has finished, and can only be installed on a single context.
+     */
+    void install(xmlParserCtxtPtr context);
+};
+
+#endif  // SVG_CONVERTER_ELEMENT_FILTER_H_
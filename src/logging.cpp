@@ -1,11 +1,21 @@
 #include "logging.h"
 
+#include <utility>
+
+/**
+ * Apply the settings shared by all loggers.
+ */
+void configure_logger(spdlog::logger& logger) {
+    logger.set_level(spdlog::level::debug);
+    logger.set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%l] %v");
+}
+
 spdlog::logger& setup_global_logger() {
-    // Because this program is completely single threaded, we can afford to use
-    // normal references instead of shared pointers.
-    auto logger_ptr = spdlog::stderr_logger_st(kLoggerName);
-    logger_ptr->set_level(spdlog::level::debug);
-    logger_ptr->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%l] %v");
+    // The logger is registered globally and lives until the end of the
+    // program, so we can afford to use normal references instead of shared
+    // pointers.
+    auto logger_ptr = spdlog::stderr_logger_mt(kLoggerName);
+    configure_logger(*logger_ptr);
     return *logger_ptr;
 }
 
@@ -16,3 +26,12 @@ spdlog::logger& setup_global_logger() {
  * the returned reference is much cheaper).
  */
 spdlog::logger& get_global_logger() { return *spdlog::get(kLoggerName); }
+
+std::unique_ptr<spdlog::logger> create_file_logger(
+    const std::string& name, const std::string& filename) {
+    auto sink =
+        std::make_shared<spdlog::sinks::simple_file_sink_st>(filename, true);
+    auto logger = std::make_unique<spdlog::logger>(name, std::move(sink));
+    configure_logger(*logger);
+    return logger;
+}
@@ -1,12 +1,18 @@
 #ifndef SVG_CONVERTER_LOGGING_H_H
 #define SVG_CONVERTER_LOGGING_H_H
 
+#include <memory>
+#include <string>
+
 #include <spdlog/spdlog.h>
 
 constexpr const char* const kLoggerName = "console";
 
 /**
  * Setup the global logger. Should only be called once.
+ *
+ * The global logger is thread safe, so that it can be used to report progress
+ * from multiple conversions running in parallel.
  */
 spdlog::logger& setup_global_logger();
 
@@ -18,4 +24,13 @@ spdlog::logger& setup_global_logger();
  */
 spdlog::logger& get_global_logger();
 
+/**
+ * Creates a logger writing to the given file, truncating it.
+ *
+ * The logger is not registered globally and not thread safe, it is meant to
+ * collect the messages of a single conversion.
+ */
+std::unique_ptr<spdlog::logger> create_file_logger(const std::string& name,
+                                                   const std::string& filename);
+
 #endif  // SVG_CONVERTER_LOGGING_H_H
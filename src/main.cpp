@@ -1,30 +1,303 @@
+#include <getopt.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
 #include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
 
+#include "batch.h"
 #include "conversion.h"
 #include "logging.h"
+#include "output_sink.h"
+#include "stats.h"
 #include "svg.h"
+#include "svg_stream.h"
+#include "thread_pool.h"
+#include "trace.h"
 
-SvgDocument load_svg(spdlog::logger& logger, const std::string& filename) {
-    try {
-        return SvgDocument{filename};
-    } catch (const SvgLoadError& err) {
-        logger.critical("Failed to load svg: {}", err.what());
-        std::exit(1);
+/**
+ * Amount of output after which it is written to stdout at the end of a shape.
+ *
+ * Small enough for a plotter reading from a pipe to start almost immediately,
+ * large enough to not issue a system call for every short line.
+ */
+constexpr std::size_t kStdoutFlushThreshold = 4096;
+
+SvgDocument load_svg(const std::string& filename) {
+    if (filename == "-") {
+        return SvgDocument::read_stream(STDIN_FILENO, "stdin");
+    }
+
+    return SvgDocument{filename};
+}
+
+SvgStream open_svg_stream(const std::string& filename) {
+    if (filename == "-") {
+        return SvgStream::from_fd(STDIN_FILENO, "stdin");
+    }
+
+    return SvgStream{filename};
+}
+
+/**
+ * Writes the statistics report to stderr, or to a file if a name is given.
+ *
+ * @return False if the file couldn't be written.
+ */
+bool write_stats(const Stats& stats,
+                 std::chrono::steady_clock::duration wall_time,
+                 std::size_t files, const std::string& filename,
+                 spdlog::logger& logger) {
+    if (filename.empty()) {
+        write_stats_json(std::cerr, stats, wall_time, files);
+        return true;
+    }
+
+    std::ofstream out{filename};
+    write_stats_json(out, stats, wall_time, files);
+    out.close();
+    if (!out) {
+        logger.error("Failed to write statistics to {}", filename);
+        return false;
     }
+
+    return true;
+}
+
+/**
+ * Stops tracing and writes the recorded events to a file.
+ *
+ * @return False if the file couldn't be written.
+ */
+bool write_trace(const std::string& filename, spdlog::logger& logger) {
+    stop_tracing();
+    std::ofstream out{filename};
+    write_trace_json(out);
+    out.close();
+    if (!out) {
+        logger.error("Failed to write trace to {}", filename);
+        return false;
+    }
+
+    return true;
+}
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] (filename.svg | -)\n"
+              << "       " << program
+              << " --batch [options] (directory | glob | -)...\n"
+              << R"(
+Converts a single file, or stdin if - is given, and writes the GPGL program
+to stdout as it is generated.
+
+Options:
+  --batch              Convert many files, writing a .gpgl and .err file next
+                       to each input. A directory converts all .svg and .svgz
+                       files in it, - reads filenames from stdin, one per line.
+  --jobs N             Number of files to convert in parallel in batch mode
+                       (default: number of cores).
+  --quality PRESET     Accuracy of curves: draft, normal (default) or fine.
+  --tolerance UNITS    Maximum distance between curves and the generated lines
+                       in GPGL units (1/20 mm), overrides --quality.
+  --simplify           Drop duplicate points and merge collinear lines after
+                       rounding to GPGL units.
+  --simplify-tolerance UNITS
+                       Maximum distance of merged points from a simplified
+                       line in GPGL units (default: 0.5), implies --simplify.
+  --threads N          Number of threads for clipping patterns of a single file
+                       (default: number of cores, 1 in batch mode).
+  --optimize-travel    Reorder and reverse lines to reduce pen-up travel.
+  --travel-budget MS   Time in milliseconds that may be spent on reordering
+                       per document (default: 250), implies --optimize-travel.
+  --stream             Convert shapes while the document is being read instead
+                       of loading it completely first. Keeps memory usage low
+                       for huge documents.
+  --stats json         Report counters and the time spent in each phase as a
+                       JSON object on stderr, summed over all files.
+  --stats-file FILE    Write the report to FILE instead, implies --stats json.
+  --trace FILE         Record a timeline of elements and phases on all threads
+                       and write it to FILE in the Chrome trace format, for
+                       chrome://tracing or Perfetto.
+)";
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " filename.svg\n";
+    enum Option { kBatch, kJobs, kQuality, kTolerance, kSimplify,
+                  kSimplifyTolerance, kOptimizeTravel, kTravelBudget,
+                  kThreads, kStream, kStats, kStatsFile, kTrace };
+    const option long_options[] = {
+        {"batch", no_argument, nullptr, kBatch},
+        {"jobs", required_argument, nullptr, kJobs},
+        {"quality", required_argument, nullptr, kQuality},
+        {"tolerance", required_argument, nullptr, kTolerance},
+        {"simplify", no_argument, nullptr, kSimplify},
+        {"simplify-tolerance", required_argument, nullptr, kSimplifyTolerance},
+        {"optimize-travel", no_argument, nullptr, kOptimizeTravel},
+        {"travel-budget", required_argument, nullptr, kTravelBudget},
+        {"threads", required_argument, nullptr, kThreads},
+        {"stream", no_argument, nullptr, kStream},
+        {"stats", required_argument, nullptr, kStats},
+        {"stats-file", required_argument, nullptr, kStatsFile},
+        {"trace", required_argument, nullptr, kTrace},
+        {nullptr, 0, nullptr, 0}};
+
+    bool batch = false;
+    unsigned jobs = default_thread_count();
+    unsigned threads = 0;
+    ConversionOptions options;
+    bool stats = false;
+    std::string stats_filename;
+    std::string trace_filename;
+    bool valid = true;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+        switch (opt) {
+            case kBatch:
+                batch = true;
+                break;
+            case kJobs:
+                jobs = static_cast<unsigned>(std::strtoul(optarg, nullptr, 10));
+                valid = valid && jobs > 0;
+                break;
+            case kQuality:
+                if (std::strcmp(optarg, "draft") == 0) {
+                    options.tolerance = quality_tolerance(Quality::kDraft);
+                } else if (std::strcmp(optarg, "normal") == 0) {
+                    options.tolerance = quality_tolerance(Quality::kNormal);
+                } else if (std::strcmp(optarg, "fine") == 0) {
+                    options.tolerance = quality_tolerance(Quality::kFine);
+                } else {
+                    valid = false;
+                }
+                break;
+            case kTolerance:
+                options.tolerance = std::strtod(optarg, nullptr);
+                valid = valid && options.tolerance > 0 &&
+                        std::isfinite(options.tolerance);
+                break;
+            case kSimplify:
+                options.simplify = true;
+                break;
+            case kSimplifyTolerance:
+                options.simplify = true;
+                options.simplify_tolerance = std::strtod(optarg, nullptr);
+                valid = valid && options.simplify_tolerance >= 0 &&
+                        std::isfinite(options.simplify_tolerance);
+                break;
+            case kOptimizeTravel:
+                options.optimize_travel = true;
+                break;
+            case kTravelBudget:
+                options.optimize_travel = true;
+                options.travel_time_budget = std::chrono::milliseconds{
+                    std::strtol(optarg, nullptr, 10)};
+                valid = valid && options.travel_time_budget.count() >= 0;
+                break;
+            case kThreads:
+                threads = static_cast<unsigned>(
+                    std::strtoul(optarg, nullptr, 10));
+                valid = valid && threads > 0;
+                break;
+            case kStream:
+                options.stream = true;
+                break;
+            case kStats:
+                // JSON is the only format so far
+                stats = true;
+                valid = valid && std::strcmp(optarg, "json") == 0;
+                break;
+            case kStatsFile:
+                stats = true;
+                stats_filename = optarg;
+                break;
+            case kTrace:
+                trace_filename = optarg;
+                break;
+            default:
+                valid = false;
+                break;
+        }
+    }
+
+    // Files are already converted in parallel in batch mode
+    if (threads == 0) {
+        threads = batch ? 1 : default_thread_count();
+    }
+
+    options.threads = threads;
+
+    std::vector<std::string> inputs{argv + optind, argv + argc};
+    if (!valid || inputs.empty() || (!batch && inputs.size() != 1)) {
+        print_usage(argv[0]);
         return 1;
     }
 
     LIBXML_TEST_VERSION
 
     spdlog::logger& logger = setup_global_logger();
-    auto doc = load_svg(logger, argv[1]);
-    std::cout << convert(doc);
 
-    return 0;
+    if (!trace_filename.empty()) {
+        start_tracing();
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    if (batch) {
+        auto files = expand_batch_inputs(inputs, logger);
+        auto results = convert_batch(files, jobs, options);
+        auto total_duration = std::chrono::steady_clock::now() - start_time;
+        log_batch_summary(results, total_duration, logger);
+        bool success =
+            trace_filename.empty() || write_trace(trace_filename, logger);
+        Stats total_stats;
+        for (const auto& result : results) {
+            success = success && result.success;
+            total_stats += result.stats;
+        }
+
+        if (stats) {
+            success = write_stats(total_stats, total_duration, results.size(),
+                                  stats_filename, logger) &&
+                      success;
+        }
+
+        return success ? 0 : 1;
+    }
+
+    const Stats stats_before = current_thread_stats();
+    bool success = true;
+    OutputSink sink{fd_write_function(STDOUT_FILENO), kStdoutFlushThreshold};
+    try {
+        if (options.stream) {
+            SvgStream stream = open_svg_stream(inputs.front());
+            convert(stream, logger, sink, options);
+        } else {
+            auto doc = load_svg(inputs.front());
+            convert(doc, logger, sink, options);
+        }
+    } catch (const SvgLoadError& err) {
+        logger.critical("Failed to load svg: {}", err.what());
+        success = false;
+    } catch (const std::system_error& err) {
+        logger.critical("{}", err.what());
+        success = false;
+    }
+
+    if (!trace_filename.empty()) {
+        success = write_trace(trace_filename, logger) && success;
+    }
+
+    if (stats) {
+        success = write_stats(current_thread_stats() - stats_before,
+                              std::chrono::steady_clock::now() - start_time, 1,
+                              stats_filename, logger) &&
+                  success;
+    }
+
+    return success ? 0 : 1;
 }
@@ -0,0 +1,76 @@
+#include "output_sink.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <system_error>
+#include <utility>
+
+#include "stats.h"
+
+constexpr std::size_t OutputSink::kDefaultBufferSize;
+constexpr std::size_t OutputSink::kMinBufferSize;
+
+OutputSink::OutputSink(WriteFunction write_function,
+                       std::size_t flush_threshold, std::size_t buffer_size)
+    : write_function_{std::move(write_function)},
+      buffer_(std::max(buffer_size, kMinBufferSize)),
+      flush_threshold_{flush_threshold} {}
+
+void OutputSink::flush() {
+    if (used_ == 0) {
+        return;
+    }
+
+    // Reset before writing, so that a throwing write function doesn't leave
+    // the data around to be written again.
+    std::size_t size = used_;
+    used_ = 0;
+    bytes_written_ += size;
+    count_stat(StatsCounter::kBytesWritten, size);
+    ScopedPhase phase{StatsPhase::kOutput};
+    write_function_(buffer_.data(), size);
+}
+
+void OutputSink::write_slow(const char* data, std::size_t size) {
+    flush();
+    if (size >= buffer_.size()) {
+        bytes_written_ += size;
+        count_stat(StatsCounter::kBytesWritten, size);
+        ScopedPhase phase{StatsPhase::kOutput};
+        write_function_(data, size);
+    } else {
+        std::memcpy(buffer_.data(), data, size);
+        used_ = size;
+    }
+}
+
+OutputSink::WriteFunction fd_write_function(int fd) {
+    return [fd](const char* data, std::size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                throw std::system_error{errno, std::generic_category(),
+                                        "Failed to write output"};
+            }
+
+            data += written;
+            size -= static_cast<std::size_t>(written);
+        }
+    };
+}
+
+OutputSink::WriteFunction file_write_function(std::FILE* file) {
+    return [file](const char* data, std::size_t size) {
+        if (std::fwrite(data, 1, size, file) != size ||
+            std::fflush(file) != 0) {
+            throw std::system_error{errno, std::generic_category(),
+                                    "Failed to write output"};
+        }
+    };
+}
@@ -0,0 +1,139 @@
+#ifndef SVG_CONVERTER_OUTPUT_SINK_H_
+#define SVG_CONVERTER_OUTPUT_SINK_H_
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+/**
+ * Buffered destination for the generated output.
+ *
+ * Written data is collected in a buffer of fixed size and passed on to a write
+ * function, so that output can be produced while the document is still being
+ * converted instead of building it in memory first.
+ *
+ * The buffer is passed on when it is full, when `flush` is called, and at the
+ * end of a shape once at least `flush_threshold` bytes have been collected.
+ * A threshold of zero passes on the output of every shape as soon as it is
+ * finished, a threshold equal to the buffer size only passes on full buffers.
+ */
+class OutputSink {
+ public:
+    /**
+     * Function receiving the buffered data.
+     *
+     * Must either consume all data or throw.
+     */
+    using WriteFunction =
+        std::function<void(const char* data, std::size_t size)>;
+
+    static constexpr std::size_t kDefaultBufferSize = 64 * 1024;
+
+    /**
+     * Smallest supported buffer size, smaller buffer sizes are rounded up.
+     *
+     * Guarantees that `reserve` can provide space for a reasonable amount of
+     * bytes.
+     */
+    static constexpr std::size_t kMinBufferSize = 256;
+
+ private:
+    WriteFunction write_function_;
+    std::vector<char> buffer_;
+    std::size_t used_ = 0;
+    std::size_t flush_threshold_;
+    std::size_t bytes_written_ = 0;
+
+ public:
+    /**
+     * Creates a new sink.
+     *
+     * @param write_function Function to pass the buffered data to.
+     * @param flush_threshold Number of bytes after which the output is passed
+     *                        on at the end of a shape.
+     * @param buffer_size Size of the buffer. Writes larger than the buffer are
+     *                    passed on directly. Smaller sizes are rounded up to
+     *                    `kMinBufferSize`.
+     */
+    explicit OutputSink(WriteFunction write_function,
+                        std::size_t flush_threshold = kDefaultBufferSize,
+                        std::size_t buffer_size = kDefaultBufferSize);
+
+    /**
+     * Appends data to the output.
+     */
+    void write(const char* data, std::size_t size) {
+        if (size > buffer_.size() - used_) {
+            write_slow(data, size);
+            return;
+        }
+
+        std::memcpy(buffer_.data() + used_, data, size);
+        used_ += size;
+    }
+
+    /**
+     * Provides space to write up to `size` bytes directly into the buffer.
+     *
+     * Avoids copying small, formatted pieces of output. Must be followed by a
+     * call to `commit` with the number of bytes actually written.
+     *
+     * @param size Number of bytes needed, at most `kMinBufferSize`.
+     */
+    char* reserve(std::size_t size) {
+        if (size > buffer_.size() - used_) {
+            flush();
+        }
+
+        return buffer_.data() + used_;
+    }
+
+    /**
+     * Appends the given number of bytes written to the space from `reserve`.
+     */
+    void commit(std::size_t size) { used_ += size; }
+
+    /**
+     * Marks the end of a shape, a point at which the output is consistent.
+     */
+    void end_shape() {
+        if (used_ > 0 && used_ >= flush_threshold_) {
+            flush();
+        }
+    }
+
+    /**
+     * Passes on all buffered data.
+     *
+     * Must be called once all output has been written. Not done in the
+     * destructor, because the write function might throw.
+     */
+    void flush();
+
+    /**
+     * Total number of bytes written to the sink so far.
+     */
+    std::size_t bytes_written() const { return bytes_written_ + used_; }
+
+ private:
+    void write_slow(const char* data, std::size_t size);
+};
+
+/**
+ * Creates a write function writing to a file descriptor.
+ *
+ * Throws `std::system_error` on write errors.
+ */
+OutputSink::WriteFunction fd_write_function(int fd);
+
+/**
+ * Creates a write function writing to a C stdio stream.
+ *
+ * The stream is flushed after each write, so that data is not held back in a
+ * second buffer. Throws `std::system_error` on write errors.
+ */
+OutputSink::WriteFunction file_write_function(std::FILE* file);
+
+#endif  // SVG_CONVERTER_OUTPUT_SINK_H_
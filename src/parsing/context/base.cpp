@@ -1,12 +1,21 @@
 #include "base.h"
 
+#include "../../stats.h"
+
 detail::BaseContextExporterless::BaseContextExporterless(
     const SvgDocument& document, spdlog::logger& logger,
-    const Viewport& viewport, const Transform& to_root)
+    const Viewport& viewport, const Transform& to_root,
+    PatternCache& pattern_cache, const FlatteningTolerance& tolerance,
+    unsigned clip_threads)
     : to_root_{to_root},
       document_{document},
       logger_{logger},
-      viewport_{viewport} {}
+      viewport_{viewport},
+      pattern_cache_{pattern_cache},
+      tolerance_{tolerance},
+      clip_threads_{clip_threads} {
+    count_stat(StatsCounter::kElementsVisited);
+}
 
 void detail::BaseContextExporterless::transform_matrix(
     const boost::array<double, 6>& matrix) {
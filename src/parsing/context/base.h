@@ -5,8 +5,12 @@
 #include <spdlog/spdlog.h>  // NOLINT
 #include <boost/array.hpp>  // NOLINT
 
+#include "../../bezier.h"
 #include "../../math_defs.h"
 #include "../../svg.h"
+#include "../../trace.h"
+#include "../pattern_cache.h"
+#include "../svgpp.h"
 #include "../viewport.h"
 
 namespace detail {
@@ -47,9 +51,42 @@ class BaseContextExporterless {
      */
     const Viewport& viewport_;
 
+    /**
+     * Cache for the paths generated by referenced patterns.
+     *
+     * Shared by all elements of the document being parsed.
+     */
+    PatternCache& pattern_cache_;
+
+    /**
+     * Tolerance for flattening paths in the root coordinate system.
+     */
+    FlatteningTolerance tolerance_;
+
+    /**
+     * Number of threads to use for clipping patterns.
+     */
+    unsigned clip_threads_;
+
+    /**
+     * Event of the element in a trace.
+     */
+    ElementTrace trace_;
+
  protected:
     BaseContextExporterless(const SvgDocument& document, spdlog::logger& logger,
-                            const Viewport& viewport, const Transform& to_root);
+                            const Viewport& viewport, const Transform& to_root,
+                            PatternCache& pattern_cache,
+                            const FlatteningTolerance& tolerance,
+                            unsigned clip_threads);
+
+    /**
+     * Records the element as an event lasting until the context is
+     * destructed, if tracing. Called by the derived contexts.
+     *
+     * @param name Must have static storage duration.
+     */
+    void trace_element(const char* name) { trace_.begin(name); }
 
  public:
     /**
@@ -72,11 +109,34 @@ class BaseContextExporterless {
      */
     const Transform& to_root() const { return to_root_; }
 
+    /**
+     * Cache for the paths generated by patterns of the document.
+     */
+    PatternCache& pattern_cache() { return pattern_cache_; }
+
+    /**
+     * Tolerance for flattening paths in the root coordinate system.
+     */
+    const FlatteningTolerance& tolerance() const { return tolerance_; }
+
+    /**
+     * Number of threads to use for clipping patterns.
+     */
+    unsigned clip_threads() const { return clip_threads_; }
+
     /**
      * Handle a transform being reported by SVG++.
      */
     void transform_matrix(const boost::array<double, 6>& matrix);
 
+    /**
+     * Handle the id attribute, which only labels the element in traces.
+     */
+    template <class Range>
+    void set(svgpp::tag::attribute::id /*unused*/, const Range& id) {
+        trace_.set_id(id);
+    }
+
     /**
      * Provides a length factory for SVG++ to resolve units.
      *
@@ -99,6 +159,7 @@ class BaseContextExporterless {
  *    coordinate system to produce a output in global coordinates.
  *  - Handling of an exporter, with which generated lines should be exported.
  *  - Access to the SVG document to find referenced elements like patterns
+ *  - Access to a document wide cache of the paths generated by patterns
  *  - Logging
  *  - Functionality to disable processing of child elements dynamically. All
  *    derived classes must define a constant `process_children` method, that
@@ -116,7 +177,9 @@ class BaseContext : public detail::BaseContextExporterless {
     Exporter exporter_;
 
     BaseContext(const SvgDocument& document, spdlog::logger& logger,
-                Exporter exporter, const Viewport& viewport, Transform to_root);
+                Exporter exporter, const Viewport& viewport, Transform to_root,
+                PatternCache& pattern_cache,
+                const FlatteningTolerance& tolerance, unsigned clip_threads);
 
  public:
     /**
@@ -133,8 +196,17 @@ class BaseContext : public detail::BaseContextExporterless {
 template <class Exporter>
 BaseContext<Exporter>::BaseContext(const SvgDocument& document,
                                    spdlog::logger& logger, Exporter exporter,
-                                   const Viewport& viewport, Transform to_root)
-    : detail::BaseContextExporterless{document, logger, viewport, to_root},
+                                   const Viewport& viewport, Transform to_root,
+                                   PatternCache& pattern_cache,
+                                   const FlatteningTolerance& tolerance,
+                                   unsigned clip_threads)
+    : detail::BaseContextExporterless{document,
+                                      logger,
+                                      viewport,
+                                      to_root,
+                                      pattern_cache,
+                                      tolerance,
+                                      clip_threads},
       exporter_{exporter} {}
 
 template <class Exporter>
@@ -142,7 +214,10 @@ template <class ParentContext>
 BaseContext<Exporter>::BaseContext(ParentContext& parent)
     : detail::BaseContextExporterless{parent.document(), parent.logger(),
                                       parent.inner_viewport(),
-                                      parent.to_root()},
+                                      parent.to_root(),
+                                      parent.pattern_cache(),
+                                      parent.tolerance(),
+                                      parent.clip_threads()},
       exporter_{parent.inner_exporter()} {}
 
 #endif  // SVG_CONVERTER_PARSING_CONTEXT_BASE_H_
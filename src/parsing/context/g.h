@@ -37,6 +37,8 @@ class GContext : public BaseContext<Exporter> {
 template <class Exporter>
 template <class ParentContext>
 GContext<Exporter>::GContext(ParentContext& parent)
-    : BaseContext<Exporter>{parent} {}
+    : BaseContext<Exporter>{parent} {
+    this->trace_element("g");
+}
 
 #endif  // SVG_CONVERTER_PARSING_CONTEXT_G_H_
@@ -1,11 +1,21 @@
 #include "pattern.h"
 
+#include <boost/functional/hash.hpp>
 #include <boost/variant.hpp>
 #include <eigen3/Eigen/SVD>
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <exception>
+#include <iterator>
+#include <unordered_map>
 #include <utility>
 
+#include "../../stats.h"
+#include "../../thread_pool.h"
+#include "../../trace.h"
+
 /**
  * Scale factor applied before rounding to integer coordinates for clipping.
  *
@@ -13,6 +23,14 @@
  */
 constexpr double kClipperAccuracyFactor = 10;
 
+/**
+ * Number of boundary tiles clipped together by one clipper instance.
+ *
+ * Fixed, so that the output doesn't depend on the number of threads. Each
+ * instance processes the whole clipping path, so bands must not be too small.
+ */
+constexpr std::size_t kTilesPerClipBand = 256;
+
 ClipperLib::IntPoint to_clipper_point(const Vector& point) {
     auto int_point = (point * kClipperAccuracyFactor)
                          .array()
@@ -21,61 +39,6 @@ ClipperLib::IntPoint to_clipper_point(const Vector& point) {
     return {int_point(0), int_point(1)};
 }
 
-/**
- * Polyline visitor created from two lambdas.
- *
- * The first lambda gets called for each point, the second at the end of the
- * polyline.
- *
- * Because the visitor needs to be able to be moved (to be returned from the
- * factory function), this implementation has to track whether an instance has
- * been moved. If it has been moved, we don't call the on end function in the
- * destructor.
- */
-// TODO(David): Maybe refactor Path::to_polylines to not use the destructor?
-template <class PointFunc, class OnEndFunc>
-class DualLambdaPolylineVisitor {
- private:
-    PointFunc point_func_;
-    OnEndFunc on_end_func_;
-
-    /**
-     * Needed to save whether this visitor was moved out of.
-     */
-    bool is_alive = true;
-
- public:
-    DualLambdaPolylineVisitor(PointFunc point_func, OnEndFunc on_end_func)
-        : point_func_{point_func}, on_end_func_{on_end_func} {}
-
-    // Make move only
-    DualLambdaPolylineVisitor(const DualLambdaPolylineVisitor&) = delete;
-    DualLambdaPolylineVisitor& operator=(const DualLambdaPolylineVisitor&) =
-        delete;
-
-    DualLambdaPolylineVisitor(DualLambdaPolylineVisitor&& other) noexcept
-        : point_func_{other.point_func_}, on_end_func_{other.on_end_func_} {
-        other.is_alive = false;
-    }
-
-    DualLambdaPolylineVisitor& operator=(
-        DualLambdaPolylineVisitor&& other) noexcept {
-        point_func_ = other.point_func_;
-        on_end_func_ = other.on_end_func_;
-        is_alive = true;
-        other.is_alive = false;
-        return *this;
-    }
-
-    ~DualLambdaPolylineVisitor() {
-        if (is_alive) {
-            on_end_func_();
-        }
-    }
-
-    void operator()(Vector point) { point_func_(point); }
-};
-
 /**
  * Visitor that calculates the correct viewbox from attributes.
  *
@@ -112,16 +75,6 @@ class ViewboxVisitor
     }
 };
 
-/**
- * Creates a `DualLambdaPolylineVisitor` with perfect forwarding.
- */
-template <class PointFunc, class OnEndFunc>
-DualLambdaPolylineVisitor<PointFunc, OnEndFunc> make_dual_lambda_visitor(
-    PointFunc&& point_func, OnEndFunc&& on_end_func) {
-    return {std::forward<PointFunc>(point_func),
-            std::forward<OnEndFunc>(on_end_func)};
-}
-
 boost::optional<std::tuple<Transform, Vector>> detail::calculate_pattern_layout(
     const PatternLayoutAttributes& attribs, Vector bbox_size,
     const Viewport& viewport) {
@@ -195,22 +148,206 @@ boost::optional<std::tuple<Transform, Vector>> detail::calculate_pattern_layout(
 #pragma clang diagnostic pop
 }
 
-std::vector<Vector> detail::compute_tiling_offsets(const Vector& pattern_size,
-                                                   const Transform& to_root,
-                                                   const Path& clipping_path) {
-    // We use a very simple approach to tiling here: In the coordinate system
-    // it is defined in, the pattern is a rectangle located at (0, 0). We add an
-    // additional scale, so that the size of the pattern is (1, 1). Then we take
-    // the inverse of that and transform our clipping path into this coordinate
-    // system. We build the bounding box of the clipping path and round it
-    // outward to the nearest integer coordinates. Now we can just enumerate
-    // all integer coordinates in the bounding box and transform them into
-    // root space.
-    //
-    // An alternative approach that would not require inverting a matrix would
-    // be to use the fact, that the affine transformation to root space can
-    // only transform the rectangle into a parallelogram, and than doing
-    // parallelogram tiling in root space.
+/**
+ * Coverage of a cell of the tile grid by the clipping path.
+ */
+enum class CellCoverage : std::uint8_t { kOutside, kBoundary, kInterior };
+
+/**
+ * Coverage of the cells with integer corners by a set of polygons.
+ */
+struct CoverageGrid {
+    std::int64_t min_column;
+    std::int64_t min_row;
+    std::int64_t columns;
+    std::int64_t rows;
+
+    /**
+     * Coverage of all cells, row by row.
+     */
+    std::vector<CellCoverage> cells;
+
+    CellCoverage& at(std::int64_t column, std::int64_t row) {
+        return cells[static_cast<std::size_t>(row * columns + column)];
+    }
+};
+
+/**
+ * Marks all cells touched by a line segment as boundary cells.
+ *
+ * Conservative: Cells only touched at their border are marked as well.
+ */
+void mark_boundary_cells(CoverageGrid& grid, const Vector& start,
+                         const Vector& end) {
+    double min_y = std::min(start.y(), end.y());
+    double max_y = std::max(start.y(), end.y());
+    auto first_row = static_cast<std::int64_t>(std::floor(min_y));
+    auto last_row = static_cast<std::int64_t>(std::floor(max_y));
+    for (std::int64_t row = first_row; row <= last_row; row++) {
+        // Part of the segment inside of this row
+        double min_x;
+        double max_x;
+        if (start.y() == end.y()) {
+            min_x = std::min(start.x(), end.x());
+            max_x = std::max(start.x(), end.x());
+        } else {
+            double slope = (end.x() - start.x()) / (end.y() - start.y());
+            double y1 = std::max(static_cast<double>(row), min_y);
+            double y2 = std::min(static_cast<double>(row + 1), max_y);
+            double x1 = start.x() + (y1 - start.y()) * slope;
+            double x2 = start.x() + (y2 - start.y()) * slope;
+            min_x = std::min(x1, x2);
+            max_x = std::max(x1, x2);
+        }
+
+        auto first_column = std::max(
+            static_cast<std::int64_t>(std::floor(min_x)), grid.min_column);
+        auto last_column =
+            std::min(static_cast<std::int64_t>(std::floor(max_x)),
+                     grid.min_column + grid.columns - 1);
+        std::int64_t grid_row =
+            std::min(std::max(row - grid.min_row, std::int64_t{0}),
+                     grid.rows - 1);
+        for (std::int64_t column = first_column; column <= last_column;
+             column++) {
+            grid.at(column - grid.min_column, grid_row) =
+                CellCoverage::kBoundary;
+        }
+    }
+}
+
+/**
+ * Rasterises polygons onto the grid of cells with integer corners.
+ *
+ * Cells touched by any edge are boundary cells. All other cells are
+ * completely inside or outside of the polygons, which is decided by the
+ * even-odd rule along a scanline through the centers of the cells.
+ *
+ * @param bounds Bounding box of all polygons, must not be empty.
+ */
+CoverageGrid rasterize_polygons(
+    const std::vector<std::vector<Vector>>& polygons, const Rect& bounds) {
+    CoverageGrid grid;
+    grid.min_column = static_cast<std::int64_t>(std::floor(bounds.min().x()));
+    grid.min_row = static_cast<std::int64_t>(std::floor(bounds.min().y()));
+    grid.columns = static_cast<std::int64_t>(std::floor(bounds.max().x())) -
+                   grid.min_column + 1;
+    grid.rows = static_cast<std::int64_t>(std::floor(bounds.max().y())) -
+                grid.min_row + 1;
+    grid.cells.assign(static_cast<std::size_t>(grid.columns * grid.rows),
+                      CellCoverage::kOutside);
+
+    // X coordinates where the edges cross the center line of each row
+    std::vector<std::vector<double>> crossings(
+        static_cast<std::size_t>(grid.rows));
+    for (const auto& polygon : polygons) {
+        for (std::size_t i = 0; i < polygon.size(); i++) {
+            const Vector& start = polygon[i];
+            const Vector& end = polygon[(i + 1) % polygon.size()];
+            mark_boundary_cells(grid, start, end);
+            if (start.y() == end.y()) {
+                continue;
+            }
+
+            // Half open interval, so that vertices on a center line are
+            // counted once
+            double min_y = std::min(start.y(), end.y());
+            double max_y = std::max(start.y(), end.y());
+            double slope = (end.x() - start.x()) / (end.y() - start.y());
+            for (auto row = static_cast<std::int64_t>(std::ceil(min_y - 0.5));
+                 static_cast<double>(row) + 0.5 < max_y; row++) {
+                double center_y = static_cast<double>(row) + 0.5;
+                crossings[static_cast<std::size_t>(row - grid.min_row)]
+                    .push_back(start.x() + (center_y - start.y()) * slope);
+            }
+        }
+    }
+
+    for (std::int64_t row = 0; row < grid.rows; row++) {
+        auto& row_crossings = crossings[static_cast<std::size_t>(row)];
+        std::sort(row_crossings.begin(), row_crossings.end());
+        std::size_t crossed = 0;
+        for (std::int64_t column = 0; column < grid.columns; column++) {
+            double center_x =
+                static_cast<double>(grid.min_column + column) + 0.5;
+            while (crossed < row_crossings.size() &&
+                   row_crossings[crossed] < center_x) {
+                crossed++;
+            }
+
+            CellCoverage& cell = grid.at(column, row);
+            if (cell == CellCoverage::kOutside && crossed % 2 == 1) {
+                cell = CellCoverage::kInterior;
+            }
+        }
+    }
+
+    return grid;
+}
+
+/**
+ * Summed area table for counting cells in rectangular ranges.
+ */
+class CellCounts {
+ private:
+    std::int64_t columns_;
+    std::vector<std::uint32_t> sums_;
+
+ public:
+    template <class Predicate>
+    CellCounts(const CoverageGrid& grid, Predicate predicate)
+        : columns_{grid.columns + 1},
+          sums_(static_cast<std::size_t>((grid.columns + 1) * (grid.rows + 1)),
+                0) {
+        for (std::int64_t row = 0; row < grid.rows; row++) {
+            for (std::int64_t column = 0; column < grid.columns; column++) {
+                std::uint32_t count = predicate(
+                    grid.cells[static_cast<std::size_t>(row * grid.columns +
+                                                        column)]);
+                sum(column + 1, row + 1) = count + sum(column, row + 1) +
+                                           sum(column + 1, row) -
+                                           sum(column, row);
+            }
+        }
+    }
+
+    std::uint32_t& sum(std::int64_t column, std::int64_t row) {
+        return sums_[static_cast<std::size_t>(row * columns_ + column)];
+    }
+
+    /**
+     * Number of matching cells in the given inclusive range.
+     */
+    std::uint32_t count(std::int64_t min_column, std::int64_t min_row,
+                        std::int64_t max_column, std::int64_t max_row) {
+        return sum(max_column + 1, max_row + 1) - sum(min_column, max_row + 1) -
+               sum(max_column + 1, min_row) + sum(min_column, min_row);
+    }
+};
+
+Rect detail::pattern_content_bounds(
+    const std::vector<DashedPath>& pattern_paths) {
+    Rect bounds;
+    for (const auto& path : pattern_paths) {
+        bounds.extend(path.bounding_box());
+    }
+
+    return bounds;
+}
+
+std::vector<detail::PatternTile> detail::compute_tiling(
+    const Vector& pattern_size, const Transform& to_root,
+    const Rect& content_bounds, const Path& clipping_path,
+    const FlatteningTolerance& tolerance) {
+    ScopedPhase phase{StatsPhase::kTiling};
+
+    // In the coordinate system it is defined in, the pattern is a rectangle
+    // located at (0, 0). We add an additional scale, so that the size of the
+    // pattern is (1, 1). Then we take the inverse of that and transform our
+    // clipping path into this coordinate system. In there, the tiles are the
+    // cells of the integer grid, so we can rasterise the clipping path onto
+    // it to find the tiles that overlap it. Finally, the integer coordinates
+    // of these tiles are transformed back into root space.
 
     // Transforms from the unit coordinate system (were one instance of the
     // pattern is (1, 1) in size) to and from the root coordinate system.
@@ -219,83 +356,346 @@ std::vector<Vector> detail::compute_tiling_offsets(const Vector& pattern_size,
     Transform unit_from_root =
         unit_to_root.inverse(Eigen::TransformTraits::AffineCompact);
 
+    std::vector<std::vector<Vector>> polygons;
     Rect bounding_box;
-    clipping_path.to_polylines(
-        [&bounding_box, &unit_from_root](Vector start_point) {
-            bounding_box.extend(unit_from_root * start_point);
-            return [&bounding_box, &unit_from_root](Vector point) {
-                bounding_box.extend(unit_from_root * point);
-            };
-        });
+    clipping_path.to_polylines(tolerance, [&](Vector start_point) {
+        polygons.emplace_back();
+        polygons.back().push_back(unit_from_root * start_point);
+        bounding_box.extend(polygons.back().back());
+        return [&](Vector point) {
+            polygons.back().push_back(unit_from_root * point);
+            bounding_box.extend(polygons.back().back());
+        };
+    });
 
-    std::vector<Vector> result;
-    Vector base_point = unit_to_root * Vector{0, 0};
+    // Tiles may have content outside of their cell, which can overlap the
+    // clipping path even though the cell does not. Its corners are enough to
+    // bound it in unit space, because the transformation is affine.
+    Rect unit_content;
+    if (!content_bounds.isEmpty()) {
+        for (auto corner : {Rect::BottomLeft, Rect::BottomRight, Rect::TopLeft,
+                            Rect::TopRight}) {
+            unit_content.extend(unit_from_root * content_bounds.corner(corner));
+        }
+    }
+
+    std::vector<PatternTile> result;
+    if (bounding_box.isEmpty() || unit_content.isEmpty() ||
+        !bounding_box.sizes().allFinite() ||
+        !unit_content.sizes().allFinite()) {
+        return result;
+    }
+
+    CoverageGrid grid = rasterize_polygons(polygons, bounding_box);
+    CellCounts covered{grid, [](CellCoverage cell) {
+                           return cell != CellCoverage::kOutside ? 1u : 0u;
+                       }};
+    CellCounts interior{grid, [](CellCoverage cell) {
+                            return cell == CellCoverage::kInterior ? 1u : 0u;
+                        }};
 
+    // Range of cells touched by the content of the tile at (0, 0)
     // int64_t can hold all reasonable values that the double coefficients can
     // have
     // Note to self: Don't cast to int to perform a floor operation, if your
     // values can be negative.
-    auto int_min_point =
-        bounding_box.min().array().floor().matrix().cast<std::int64_t>();
-    auto int_max_point =
-        bounding_box.max().array().floor().matrix().cast<std::int64_t>();
-
-    for (std::int64_t x = int_min_point(0); x <= int_max_point(0); x++) {
-        for (std::int64_t y = int_min_point(1); y <= int_max_point(1); y++) {
-            result.emplace_back(unit_to_root * Vector{x, y} - base_point);
+    auto content_min =
+        unit_content.min().array().floor().matrix().cast<std::int64_t>();
+    auto content_max =
+        unit_content.max().array().floor().matrix().cast<std::int64_t>();
+
+    Vector base_point = unit_to_root * Vector{0, 0};
+    std::int64_t max_column = grid.min_column + grid.columns - 1;
+    std::int64_t max_row = grid.min_row + grid.rows - 1;
+    for (std::int64_t x = grid.min_column - content_max(0);
+         x <= max_column - content_min(0); x++) {
+        for (std::int64_t y = grid.min_row - content_max(1);
+             y <= max_row - content_min(1); y++) {
+            // Cells touched by the content of this tile, relative to the grid
+            std::int64_t first_column = x + content_min(0) - grid.min_column;
+            std::int64_t last_column = x + content_max(0) - grid.min_column;
+            std::int64_t first_row = y + content_min(1) - grid.min_row;
+            std::int64_t last_row = y + content_max(1) - grid.min_row;
+            bool clamped = first_column < 0 || first_row < 0 ||
+                           last_column >= grid.columns ||
+                           last_row >= grid.rows;
+            first_column = std::max(first_column, std::int64_t{0});
+            first_row = std::max(first_row, std::int64_t{0});
+            last_column = std::min(last_column, grid.columns - 1);
+            last_row = std::min(last_row, grid.rows - 1);
+
+            if (covered.count(first_column, first_row, last_column,
+                              last_row) == 0) {
+                continue;
+            }
+
+            auto cell_count = static_cast<std::uint32_t>(
+                (last_column - first_column + 1) * (last_row - first_row + 1));
+            bool is_interior =
+                !clamped && interior.count(first_column, first_row,
+                                           last_column, last_row) == cell_count;
+            result.push_back(
+                {unit_to_root * Vector{x, y} - base_point, is_interior});
         }
     }
 
     return result;
 }
 
-ClipperLib::PolyTree detail::clip_tiled_pattern(
-    const Path& clipping_path, const std::vector<DashedPath>& pattern_paths,
+/**
+ * Clips translated copies of polylines against a set of closed paths.
+ *
+ * @return Clipped open paths.
+ */
+ClipperLib::Paths clip_translated_polylines(
+    const ClipperLib::Paths& clip_paths,
+    const std::vector<std::vector<Vector>>& polylines,
     const std::vector<Vector>& offsets) {
+    ClipperLib::Clipper clipper;
+    clipper.AddPaths(clip_paths, ClipperLib::PolyType::ptClip, true);
+
     // We reuse the same path for all paths added to the clipper instance to
     // save on memory allocation
     ClipperLib::Path clipper_path;
-    ClipperLib::Clipper clipper;
+    for (const auto& polyline : polylines) {
+        for (const Vector& offset : offsets) {
+            for (const Vector& point : polyline) {
+                clipper_path.push_back(to_clipper_point(point + offset));
+            }
+
+            clipper.AddPath(clipper_path, ClipperLib::PolyType::ptSubject,
+                            false);
+            clipper_path.clear();
+        }
+    }
 
-    clipping_path.to_polylines([&](Vector start_point) {
-        clipper_path.push_back(to_clipper_point(start_point));
-        return make_dual_lambda_visitor(
-            [&](Vector point) {
-                clipper_path.push_back(to_clipper_point(point));
-            },
-            [&]() {
-                clipper.AddPath(clipper_path, ClipperLib::PolyType::ptClip,
-                                true);
-                clipper_path.clear();
-            });
-    });
+    ClipperLib::PolyTree poly_tree;
+    clipper.Execute(ClipperLib::ClipType::ctIntersection, poly_tree);
+    ClipperLib::Paths result;
+    ClipperLib::PolyTreeToPaths(poly_tree, result);
+    return result;
+}
 
-    // Reused like `clipper_path`
-    std::vector<Vector> polyline;
+/**
+ * Total number of points in clipper paths.
+ */
+std::size_t point_count(const ClipperLib::Paths& paths) {
+    std::size_t points = 0;
+    for (const auto& path : paths) {
+        points += path.size();
+    }
+
+    return points;
+}
+
+ClipperLib::Paths detail::clip_tiled_pattern(
+    const Path& clipping_path, const std::vector<DashedPath>& pattern_paths,
+    const std::vector<PatternTile>& tiles, const FlatteningTolerance& tolerance,
+    unsigned num_threads) {
+    ScopedPhase phase{StatsPhase::kClipping};
+    std::vector<std::vector<Vector>> polylines;
     for (const auto& dashed_path : pattern_paths) {
-        dashed_path.to_polylines([&](Vector start_point) {
-            polyline.push_back(start_point);
-            return make_dual_lambda_visitor(
-                [&](Vector point) { polyline.push_back(point); },
-                [&]() {
-                    for (const Vector& offset : offsets) {
-                        for (const Vector& point : polyline) {
-                            clipper_path.push_back(
-                                to_clipper_point(point + offset));
-                        }
-
-                        clipper.AddPath(clipper_path,
-                                        ClipperLib::PolyType::ptSubject, false);
-                        clipper_path.clear();
-                    }
-
-                    polyline.clear();
-                });
+        dashed_path.to_polylines(tolerance, [&polylines](Vector start_point) {
+            polylines.push_back({start_point});
+            return [&polylines](Vector point) {
+                polylines.back().push_back(point);
+            };
         });
     }
 
-    ClipperLib::PolyTree result;
-    clipper.Execute(ClipperLib::ClipType::ctIntersection, result);
+    // Interior tiles are copied to the result directly
+    ClipperLib::Paths result;
+    std::vector<Vector> boundary_offsets;
+    for (const PatternTile& tile : tiles) {
+        if (!tile.interior) {
+            boundary_offsets.push_back(tile.offset);
+            continue;
+        }
+
+        for (const auto& polyline : polylines) {
+            if (polyline.size() < 2) {
+                continue;
+            }
+
+            result.emplace_back();
+            result.back().reserve(polyline.size());
+            for (const Vector& point : polyline) {
+                result.back().push_back(to_clipper_point(point + tile.offset));
+            }
+        }
+    }
+
+    if (boundary_offsets.empty()) {
+        return result;
+    }
+
+    ClipperLib::Paths clip_paths;
+    clipping_path.to_polylines(tolerance, [&clip_paths](Vector start_point) {
+        clip_paths.push_back({to_clipper_point(start_point)});
+        return [&clip_paths](Vector point) {
+            clip_paths.back().push_back(to_clipper_point(point));
+        };
+    });
+
+    // Boundary tiles are clipped in bands of consecutive tiles, each by its
+    // own clipper instance, so that the bands can be clipped in parallel.
+    // Results are merged in band order, so the output doesn't depend on the
+    // number of threads.
+    std::size_t band_count =
+        (boundary_offsets.size() + kTilesPerClipBand - 1) / kTilesPerClipBand;
+    std::vector<ClipperLib::Paths> band_results(band_count);
+    std::vector<std::exception_ptr> band_errors(band_count);
+    parallel_for(band_count, num_threads, [&](std::size_t band) {
+        // Bands may run on other threads, which aren't in the clipping phase
+        TraceScope trace{"clipping_band"};
+        auto begin = boundary_offsets.begin() +
+                     static_cast<long>(band * kTilesPerClipBand);
+        auto end = band + 1 == band_count
+                       ? boundary_offsets.end()
+                       : begin + static_cast<long>(kTilesPerClipBand);
+        try {
+            band_results[band] = clip_translated_polylines(
+                clip_paths, polylines, std::vector<Vector>{begin, end});
+        } catch (...) {
+            band_errors[band] = std::current_exception();
+        }
+    });
+
+    // Counted here, because the bands are clipped on other threads
+    std::size_t polyline_points = 0;
+    for (const auto& polyline : polylines) {
+        polyline_points += polyline.size();
+    }
+
+    count_stat(StatsCounter::kClipperInputPoints,
+               polyline_points * boundary_offsets.size() +
+                   point_count(clip_paths) * band_count);
+    for (std::size_t band = 0; band < band_count; band++) {
+        if (band_errors[band]) {
+            std::rethrow_exception(band_errors[band]);
+        }
+
+        count_stat(StatsCounter::kClipperOutputPoints,
+                   point_count(band_results[band]));
+
+        result.insert(result.end(),
+                      std::make_move_iterator(band_results[band].begin()),
+                      std::make_move_iterator(band_results[band].end()));
+    }
+
+    return result;
+}
+
+/**
+ * Hash for clipper points, used to find coinciding endpoints.
+ */
+struct IntPointHash {
+    std::size_t operator()(const ClipperLib::IntPoint& point) const {
+        std::size_t seed = 0;
+        boost::hash_combine(seed, point.X);
+        boost::hash_combine(seed, point.Y);
+        return seed;
+    }
+};
+
+using EndpointMap =
+    std::unordered_multimap<ClipperLib::IntPoint, std::size_t, IntPointHash>;
+
+/**
+ * Finds an unused endpoint at a point.
+ *
+ * Endpoint `2 * i` is the front of path `i`, endpoint `2 * i + 1` its back.
+ */
+boost::optional<std::size_t> find_endpoint_at(
+    const EndpointMap& endpoints, const std::vector<bool>& used,
+    const ClipperLib::IntPoint& point) {
+    auto range = endpoints.equal_range(point);
+    for (auto iter = range.first; iter != range.second; ++iter) {
+        if (!used[iter->second / 2]) {
+            return iter->second;
+        }
+    }
+
+    return boost::none;
+}
+
+/**
+ * Finds an unused endpoint at the point, or else at most one unit away from
+ * it, see `find_endpoint_at`.
+ */
+boost::optional<std::size_t> find_stitch_endpoint(
+    const EndpointMap& endpoints, const std::vector<bool>& used,
+    const ClipperLib::IntPoint& point) {
+    if (auto endpoint = find_endpoint_at(endpoints, used, point)) {
+        return endpoint;
+    }
+
+    for (ClipperLib::cInt dx = -1; dx <= 1; dx++) {
+        for (ClipperLib::cInt dy = -1; dy <= 1; dy++) {
+            if (dx == 0 && dy == 0) {
+                continue;
+            }
+
+            if (auto endpoint = find_endpoint_at(
+                    endpoints, used, {point.X + dx, point.Y + dy})) {
+                return endpoint;
+            }
+        }
+    }
+
+    return boost::none;
+}
+
+ClipperLib::Paths detail::stitch_open_paths(ClipperLib::Paths paths) {
+    EndpointMap endpoints;
+    endpoints.reserve(paths.size() * 2);
+    std::vector<bool> used(paths.size(), false);
+    for (std::size_t i = 0; i < paths.size(); i++) {
+        if (paths[i].empty()) {
+            used[i] = true;
+            continue;
+        }
+
+        endpoints.emplace(paths[i].front(), 2 * i);
+        endpoints.emplace(paths[i].back(), 2 * i + 1);
+    }
+
+    // Appends fragments to the back of a path as long as possible
+    auto extend = [&](ClipperLib::Path& path) {
+        while (path.front() != path.back()) {
+            auto endpoint =
+                find_stitch_endpoint(endpoints, used, path.back());
+            if (!endpoint) {
+                break;
+            }
+
+            ClipperLib::Path& fragment = paths[*endpoint / 2];
+            used[*endpoint / 2] = true;
+            if (*endpoint % 2 == 1) {
+                std::reverse(fragment.begin(), fragment.end());
+            }
+
+            // The first point is the current end, up to rounding. Skipping it
+            // snaps the fragment to the end instead of drawing a connector.
+            path.insert(path.end(), std::next(fragment.begin()),
+                        fragment.end());
+        }
+    };
+
+    ClipperLib::Paths result;
+    for (std::size_t i = 0; i < paths.size(); i++) {
+        if (used[i]) {
+            continue;
+        }
+
+        used[i] = true;
+        ClipperLib::Path path = std::move(paths[i]);
+        extend(path);
+        std::reverse(path.begin(), path.end());
+        extend(path);
+        result.push_back(std::move(path));
+    }
+
     return result;
 }
 
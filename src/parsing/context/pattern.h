@@ -2,6 +2,7 @@
 #define SVG_CONVERTER_PARSING_CONTEXT_PATTERN_H_
 
 #include <tuple>
+#include <utility>
 #include <vector>
 
 #include <boost/optional.hpp>
@@ -9,8 +10,10 @@
 #include <clipper.hpp>
 
 #include "../../math_defs.h"
+#include "../../stats.h"
 #include "../dashes.h"
 #include "../path.h"
+#include "../pattern_cache.h"
 #include "../traversal.h"
 #include "../viewport.h"
 #include "base.h"
@@ -103,26 +106,85 @@ boost::optional<std::tuple<Transform, Vector>> calculate_pattern_layout(
     const PatternLayoutAttributes& attribs, Vector bbox_size,
     const Viewport& viewport);
 
-/*
+/**
+ * A single instance of a tiled pattern.
+ */
+struct PatternTile {
+    /**
+     * Offset of the tile in root space.
+     */
+    Vector offset;
+
+    /**
+     * Whether the pattern content of this tile lies completely inside the
+     * clipping path, so it doesn't need to be clipped.
+     */
+    bool interior;
+};
+
+/**
+ * Bounding box of the content of a pattern.
+ *
+ * Computed from the exact bounds of the paths, so it may be slightly larger
+ * than their dashed and flattened polylines.
+ */
+Rect pattern_content_bounds(const std::vector<DashedPath>& pattern_paths);
+
+/**
  * Generate a tiling for a pattern to completely fill the given clipping path.
  *
+ * The clipping path is rasterised onto the grid of pattern tiles, so only
+ * tiles whose content can overlap the clipping path are generated.
+ *
  * @param pattern_size Size of the pattern rectangle in the coordinate system
  *                     established by to_root.
  * @param to_root Transform to the root coordinate system.
+ * @param content_bounds Bounding box of the pattern content in root space (of
+ *                       the tile at offset 0,0). May exceed the pattern
+ *                       rectangle.
  * @param clipping_path Path in global coordinates that should be completely
  *                      tiled.
- * @return List of offsets in root space. If the pattern is repeated at all the
- *         given offsets, it will completely cover the given clipping path.
- *         If the pattern needs to be tiled at its original position (offset
- *         0,0), that will be included in the list as well.
+ * @param tolerance Tolerance for flattening the clipping path.
+ * @return List of tiles. If the pattern is repeated at all their offsets, it
+ *         will completely cover the given clipping path. If the pattern needs
+ *         to be tiled at its original position (offset 0,0), that will be
+ *         included in the list as well.
  */
-std::vector<Vector> compute_tiling_offsets(const Vector& pattern_size,
-                                           const Transform& to_root,
-                                           const Path& clipping_path);
+std::vector<PatternTile> compute_tiling(const Vector& pattern_size,
+                                        const Transform& to_root,
+                                        const Rect& content_bounds,
+                                        const Path& clipping_path,
+                                        const FlatteningTolerance& tolerance);
 
-ClipperLib::PolyTree clip_tiled_pattern(
+/**
+ * Clips the pattern repeated at all tiles to the clipping path.
+ *
+ * Only boundary tiles are clipped, the paths of interior tiles are copied to
+ * the result directly. That way, the cost of clipping grows with the
+ * perimeter of the clipping path instead of its area.
+ *
+ * @param num_threads Number of threads to clip with. Doesn't affect the
+ *                    result.
+ * @return Clipped paths in clipper coordinates.
+ */
+ClipperLib::Paths clip_tiled_pattern(
     const Path& clipping_path, const std::vector<DashedPath>& pattern_paths,
-    const std::vector<Vector>& offsets);
+    const std::vector<PatternTile>& tiles, const FlatteningTolerance& tolerance,
+    unsigned num_threads);
+
+/**
+ * Joins open paths whose endpoints coincide into longer paths.
+ *
+ * Clipping a tiled pattern cuts lines crossing several tiles into one
+ * fragment per tile, each of which would need its own pen lift. Endpoints at
+ * most one clipper unit apart (in both coordinates) are considered equal, to
+ * allow for rounding the tile offsets, but coinciding ones are preferred.
+ * The joined fragment is snapped to the end it's joined to, so no connecting
+ * segment is drawn. Paths are reversed as needed.
+ *
+ * @return Joined paths. Never more than `paths`.
+ */
+ClipperLib::Paths stitch_open_paths(ClipperLib::Paths paths);
 
 Vector from_clipper_point(ClipperLib::IntPoint point);
 
@@ -136,7 +198,9 @@ Vector from_clipper_point(ClipperLib::IntPoint point);
  *
  * It needs shape specific information (like the current viewport and coordinate
  * system as well as the area being tiled with the pattern). If multiple shapes
- * use the same pattern, it is parsed once for each shape.
+ * use the same pattern, its attributes are parsed once for each shape. The
+ * paths generated by its children are cached in the document's `PatternCache`
+ * and the children are only traversed again if the layout differs.
  */
 template <class Exporter>
 class PatternContext : public BaseContext<Exporter> {
@@ -153,6 +217,21 @@ class PatternContext : public BaseContext<Exporter> {
      */
     std::vector<DashedPath> pattern_paths_;
 
+    /**
+     * Key of this pattern layout in the pattern cache.
+     *
+     * Completed once the layout is known.
+     */
+    PatternCacheKey cache_key_;
+
+    /**
+     * Paths from the pattern cache, replacing `pattern_paths_`.
+     *
+     * Null if the paths were not cached, in which case the children are
+     * traversed to fill `pattern_paths_`.
+     */
+    const std::vector<DashedPath>* cached_paths_ = nullptr;
+
     /**
      * Describes how the lengths in the contained shapes are interpreted.
      *
@@ -193,6 +272,8 @@ class PatternContext : public BaseContext<Exporter> {
     template <class ParentExporter>
     explicit PatternContext(ShapeContext<ParentExporter>& shape_context);
 
+    using BaseContext<Exporter>::set;
+
     /**
      * Used by `BaseContext` to select the viewport for child elements.
      */
@@ -220,8 +301,12 @@ class PatternContext : public BaseContext<Exporter> {
 
     /**
      * Whether child elements should be processed.
+     *
+     * Children are skipped if their paths have been found in the cache.
      */
-    bool process_children() const { return size_ != boost::none; }
+    bool process_children() const {
+        return size_ != boost::none && cached_paths_ == nullptr;
+    }
 
     /**
      * SVG++ event reporting the value of the attribute x.
@@ -321,16 +406,29 @@ template <class ParentExporter>
 PatternContext<Exporter>::PatternContext(
     ShapeContext<ParentExporter>& shape_context)
     : BaseContext<Exporter>{shape_context},
-      clipping_path_{shape_context.outline_path()} {}
+      clipping_path_{shape_context.outline_path()} {
+    cache_key_.id = shape_context.fill_fragment_iri();
+    this->trace_element("pattern");
+}
 
 template <class Exporter>
 bool PatternContext<Exporter>::notify(AfterViewportAttributesEvent /*unused*/) {
-    // Calculate bounding box of the shape being filled
-    Rect bbox;
-    clipping_path_.to_polylines([&bbox](Vector start_point) {
-        bbox.extend(start_point);
-        return [&bbox](Vector point) { bbox.extend(point); };
-    });
+    // The outline is flattened for the tiling and the clipping, and once more
+    // if it's stroked, so it's memoised
+    clipping_path_.flattened(this->tolerance());
+
+    // Bounding box of the shape being filled
+    const Rect& bbox = clipping_path_.bounding_box();
+
+    // Called before any transform attribute is parsed, so this is still the
+    // transform of the referencing shape.
+    cache_key_.to_root = this->to_root();
+    cache_key_.viewport_size = this->viewport().size();
+    cache_key_.bbox_size = Vector::Zero();
+    if (layout_attribs_.pattern_units == detail::UnitType::kObjectBoundingBox ||
+        pattern_content_units_ == detail::UnitType::kObjectBoundingBox) {
+        cache_key_.bbox_size = bbox.sizes();
+    }
 
     auto&& result = detail::calculate_pattern_layout(
         layout_attribs_, bbox.sizes(), this->viewport());
@@ -344,6 +442,10 @@ bool PatternContext<Exporter>::notify(AfterViewportAttributesEvent /*unused*/) {
         size_ = (size_->array() / bbox.sizes().array()).matrix();
     }
 
+    if (size_) {
+        cached_paths_ = this->pattern_cache().find(cache_key_);
+    }
+
     return true;
 }
 
@@ -353,13 +455,28 @@ void PatternContext<Exporter>::on_exit_element() {
         return;
     }
 
-    auto offsets =
-        detail::compute_tiling_offsets(*size_, this->to_root(), clipping_path_);
-    ClipperLib::PolyTree poly_tree =
-        detail::clip_tiled_pattern(clipping_path_, pattern_paths_, offsets);
+    if (cached_paths_ == nullptr) {
+        // Flattened for the clipping of every shape filled with the pattern
+        for (const DashedPath& path : pattern_paths_) {
+            path.memoise_flattening(this->tolerance());
+        }
+
+        cached_paths_ = &this->pattern_cache().insert(
+            std::move(cache_key_), std::move(pattern_paths_));
+    }
 
-    ClipperLib::Paths paths;
-    ClipperLib::PolyTreeToPaths(poly_tree, paths);
+    Rect content_bounds = detail::pattern_content_bounds(*cached_paths_);
+    auto tiles =
+        detail::compute_tiling(*size_, this->to_root(), content_bounds,
+                               clipping_path_, this->tolerance());
+    count_stat(StatsCounter::kTiles, tiles.size());
+    ClipperLib::Paths fragments =
+        detail::clip_tiled_pattern(clipping_path_, *cached_paths_, tiles,
+                                   this->tolerance(), this->clip_threads());
+    std::size_t fragment_count = fragments.size();
+    ClipperLib::Paths paths = detail::stitch_open_paths(std::move(fragments));
+    this->logger().debug("Joined {} pattern fragments into {} paths",
+                         fragment_count, paths.size());
 
     for (const auto& path : paths) {
         if (path.empty()) {
@@ -367,6 +484,7 @@ void PatternContext<Exporter>::on_exit_element() {
         }
 
         Path svg_path;
+        svg_path.reserve(path.size(), path.size());
         svg_path.push_command(
             MoveCommand{detail::from_clipper_point(path.front())});
         for (std::size_t i = 1; i < path.size(); i++) {
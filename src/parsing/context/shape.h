@@ -7,6 +7,7 @@
 #include <boost/mpl/set.hpp>
 
 #include "../../math_defs.h"
+#include "../../stats.h"
 #include "../dashes.h"
 #include "../path.h"
 #include "../svgpp.h"
@@ -78,6 +79,8 @@ class ShapeContext : public BaseContext<Exporter> {
     template <class ParentContext>
     explicit ShapeContext(ParentContext& parent);
 
+    using BaseContext<Exporter>::set;
+
     /**
      * Outline path of the shape.
      *
@@ -85,6 +88,13 @@ class ShapeContext : public BaseContext<Exporter> {
      */
     const Path& outline_path() const { return path_; }
 
+    /**
+     * Id of the element referenced by the `fill` attribute.
+     *
+     * Used by `PatternContext` to identify the pattern in the pattern cache.
+     */
+    const std::string& fill_fragment_iri() const { return fill_fragment_iri_; }
+
     /**
      * Used by `BaseContext` to select the viewport for child elements.
      */
@@ -187,7 +197,11 @@ class ShapeContext : public BaseContext<Exporter> {
 template <class Exporter>
 template <class ParentContext>
 ShapeContext<Exporter>::ShapeContext(ParentContext& parent)
-    : BaseContext<Exporter>{parent} {}
+    : BaseContext<Exporter>{parent} {
+    // The context is shared by all shape elements and doesn't know which one
+    // it was created for
+    this->trace_element("shape");
+}
 
 template <class Exporter>
 void ShapeContext<Exporter>::on_exit_element() {
@@ -196,6 +210,7 @@ void ShapeContext<Exporter>::on_exit_element() {
     // element. Allows us to process <pattern> only when referenced.
     using ProcessedElements = ExpectedElements;
 
+    count_stat(StatsCounter::kShapes);
     path_.transform(this->to_root());
 
     if (!fill_fragment_iri_.empty()) {
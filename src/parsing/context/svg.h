@@ -22,9 +22,16 @@ class SvgContext : public BaseContext<Exporter> {
      * Creates an SVG context for the root <svg> object.
      *
      * @param global_viewport Global viewport representing the available space.
+     * @param pattern_cache Cache for the paths generated by patterns. Must be
+     *                      valid for the lifetime of the traversal.
+     * @param tolerance Tolerance for flattening paths in the root coordinate
+     *                  system.
      */
     explicit SvgContext(const SvgDocument& document, spdlog::logger& logger,
-                        Exporter exporter, const Viewport& global_viewport);
+                        Exporter exporter, const Viewport& global_viewport,
+                        PatternCache& pattern_cache,
+                        const FlatteningTolerance& tolerance,
+                        unsigned clip_threads);
 
     template <class ParentContext>
     explicit SvgContext(ParentContext& parent);
@@ -87,18 +94,31 @@ class SvgContext : public BaseContext<Exporter> {
 template <class Exporter>
 SvgContext<Exporter>::SvgContext(const SvgDocument& document,
                                  spdlog::logger& logger, Exporter exporter,
-                                 const Viewport& global_viewport)
-    : BaseContext<Exporter>{document, logger, exporter, global_viewport,
-                            Transform::Identity()},
+                                 const Viewport& global_viewport,
+                                 PatternCache& pattern_cache,
+                                 const FlatteningTolerance& tolerance,
+                                 unsigned clip_threads)
+    : BaseContext<Exporter>{document,
+                            logger,
+                            exporter,
+                            global_viewport,
+                            Transform::Identity(),
+                            pattern_cache,
+                            tolerance,
+                            clip_threads},
       // Per SVG spec the default width and height is 100%, so the inner
       // viewport is effectively the same as the outer one.
-      inner_viewport_{global_viewport} {}
+      inner_viewport_{global_viewport} {
+    this->trace_element("svg");
+}
 
 template <class Exporter>
 template <class ParentContext>
 SvgContext<Exporter>::SvgContext(ParentContext& parent)
     : BaseContext<Exporter>{parent},
       // See remark on the constructor above.
-      inner_viewport_{this->viewport()} {}
+      inner_viewport_{this->viewport()} {
+    this->trace_element("svg");
+}
 
 #endif  // SVG_CONVERTER_PARSING_CONTEXT_SVG_H_
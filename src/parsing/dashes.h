@@ -9,6 +9,8 @@
 #include <boost/range.hpp>
 
 #include "../math_defs.h"
+#include "../stats.h"
+#include "../trace.h"
 #include "path.h"
 
 namespace detail {
@@ -100,6 +102,7 @@ DashifyingPolylineVisitor<PolylineVisitorFactory>::DashifyingPolylineVisitor(
 template <class PolylineVisitorFactory>
 void DashifyingPolylineVisitor<PolylineVisitorFactory>::report_dash(
     Vector start_point, Vector end_point) {
+    count_stat(StatsCounter::kDashes);
     auto&& visitor = wrapped_visitor_factory_(start_point);
     visitor(end_point);
 }
@@ -165,21 +168,35 @@ class DashedPath {
      */
     explicit DashedPath(Path path);
 
+    /**
+     * Bounding box of the path, which also bounds its dashes.
+     */
+    const Rect& bounding_box() const { return path_.bounding_box(); }
+
+    /**
+     * Memoises the flattening of the path, see `Path::flattened`.
+     */
+    void memoise_flattening(const FlatteningTolerance& tolerance) const {
+        path_.flattened(tolerance);
+    }
+
     /**
      * Like Path::to_polylines, only that the stroke will be dashed,
      */
     template <class PolylineVisitorFactory>
-    void to_polylines(PolylineVisitorFactory polyline_visitor_factory) const;
+    void to_polylines(const FlatteningTolerance& tolerance,
+                      PolylineVisitorFactory polyline_visitor_factory) const;
 };
 
 template <class PolylineVisitorFactory>
 void DashedPath::to_polylines(
+    const FlatteningTolerance& tolerance,
     PolylineVisitorFactory polyline_visitor_factory) const {
     if (dasharray_.empty()) {
-        path_.to_polylines(polyline_visitor_factory);
+        path_.to_polylines(tolerance, polyline_visitor_factory);
     } else {
-        path_.to_polylines([this,
-                            &polyline_visitor_factory](Vector start_point) {
+        TraceScope trace{"dashing"};
+        path_.to_polylines(tolerance, [&](Vector start_point) {
             return detail::DashifyingPolylineVisitor<PolylineVisitorFactory&>{
                 polyline_visitor_factory, to_local_, start_point, dasharray_};
         });
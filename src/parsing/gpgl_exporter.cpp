@@ -1,12 +1,52 @@
 #include "gpgl_exporter.h"
 
-#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <utility>
 
 /**
  * Factor to convert from millimeters to GPGL units.
  */
 constexpr double kMillimeterToGpglFactor = 20;
 
+/**
+ * Largest absolute coordinate written by the integer fast path.
+ */
+constexpr double kMaxFastCoordinate = 2147483647;
+
+/**
+ * Maximum length of a command written by the integer fast path.
+ *
+ * Command letter, space, two signed 32 bit integers, comma and terminator.
+ */
+constexpr std::size_t kMaxFastCommandLength = 2 + 2 * 11 + 2;
+
+/**
+ * Maximum number of points merged into a single draw by simplification.
+ *
+ * Bounds the cost of checking whether a run can be extended.
+ */
+constexpr std::size_t kMaxSimplifyRunLength = 64;
+
+/**
+ * All two digit numbers, used to convert integers two digits at a time.
+ */
+constexpr char kDigitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
 /**
  * Convert a point from millimeter based SVG space to GPGL space.
  *
@@ -18,21 +58,214 @@ Vector to_gpgl(Vector point) {
     return gpgl.array().round().matrix();
 }
 
-GpglExporter::GpglExporter(std::ostringstream& out_stream)
-    : out_stream_{out_stream} {
-    // Print double values without any decimal places.
-    // This works in tandem with the rounding done in `to_gpgl`.
-    out_stream_.get() << std::setprecision(0) << std::fixed;
+/**
+ * Whether a coordinate can be written by `write_integer_coordinate`.
+ *
+ * False for NaN.
+ */
+bool is_fast_coordinate(double value) {
+    return std::fabs(value) <= kMaxFastCoordinate;
+}
+
+/**
+ * Writes an already rounded coordinate as decimal integer.
+ *
+ * Produces the same output as printf's `%.0f` (including a sign for negative
+ * zero), but without any of its locale handling and parsing overhead.
+ *
+ * @return Pointer past the last written character.
+ */
+char* write_integer_coordinate(char* out, double value) {
+    *out = '-';
+    out += std::signbit(value) ? 1 : 0;
+
+    auto number = static_cast<std::uint32_t>(std::fabs(value));
+    char digits[10];
+    char* digits_end = digits + sizeof(digits);
+    char* digits_begin = digits_end;
+    while (number >= 100) {
+        digits_begin -= 2;
+        std::memcpy(digits_begin, &kDigitPairs[(number % 100) * 2], 2);
+        number /= 100;
+    }
+
+    if (number >= 10) {
+        digits_begin -= 2;
+        std::memcpy(digits_begin, &kDigitPairs[number * 2], 2);
+    } else {
+        *--digits_begin = static_cast<char>('0' + number);
+    }
+
+    auto length = static_cast<std::size_t>(digits_end - digits_begin);
+    std::memcpy(out, digits_begin, length);
+    return out + length;
+}
+
+FlatteningTolerance gpgl_flattening_tolerance(double gpgl_tolerance) {
+    return {std::max(gpgl_tolerance, 0.5) / kMillimeterToGpglFactor,
+            1 / kMillimeterToGpglFactor};
+}
+
+GpglWriter::GpglWriter(OutputSink& sink,
+                       boost::optional<double> simplify_tolerance)
+    : sink_{sink}, simplify_tolerance_{simplify_tolerance} {}
+
+void GpglWriter::write_command(char command, const Vector& point) {
+    if (is_fast_coordinate(point(0)) && is_fast_coordinate(point(1))) {
+        char* begin = sink_.reserve(kMaxFastCommandLength);
+        char* out = begin;
+        *out++ = command;
+        *out++ = ' ';
+        out = write_integer_coordinate(out, point(0));
+        *out++ = ',';
+        out = write_integer_coordinate(out, point(1));
+        *out++ = '\x03';
+        sink_.commit(static_cast<std::size_t>(out - begin));
+        return;
+    }
+
+    // Fallback for values that don't fit into 32 bit integers. Prints double
+    // values without any decimal places, which works in tandem with the
+    // rounding done in `to_gpgl`. A value needs at most 310 characters this
+    // way.
+    char buffer[1024];
+    int length = std::snprintf(buffer, sizeof(buffer), "%c %.0f,%.0f\x03",
+                               command, point(0), point(1));
+    sink_.write(buffer, static_cast<std::size_t>(length));
+}
+
+bool GpglWriter::extends_run(const Vector& point) const {
+    if (run_.size() < 2 || run_.size() >= kMaxSimplifyRunLength) {
+        return false;
+    }
+
+    // The run can be replaced by a single line if all its points are close to
+    // that line. Points may go back and forth along the line, because the
+    // drawn segments between them are covered by the line as well.
+    const Vector& start = run_.front();
+    Vector direction = point - start;
+    double length_squared = direction.squaredNorm();
+    if (length_squared == 0) {
+        // A stroke back to the start of the run has no direction, and all
+        // points would pass the checks below even though the run isn't a
+        // line at all
+        return false;
+    }
+
+    double max_cross = *simplify_tolerance_ * std::sqrt(length_squared);
+    for (auto iter = std::next(run_.begin()); iter != run_.end(); ++iter) {
+        Vector offset = *iter - start;
+        double projection = offset.dot(direction);
+        double cross = offset.x() * direction.y() - offset.y() * direction.x();
+        if (projection < 0 || projection > length_squared ||
+            std::abs(cross) > max_cross) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void GpglWriter::flush_run() {
+    if (run_.size() >= 2) {
+        write_command('D', run_.back());
+        run_.erase(run_.begin(), std::prev(run_.end()));
+    }
+}
+
+void GpglWriter::move_to(const Vector& point) {
+    command_count_++;
+    if (simplify_tolerance_) {
+        flush_run();
+        run_.clear();
+        if (pen_position_ && *pen_position_ == point) {
+            eliminated_command_count_++;
+            return;
+        }
+    }
+
+    write_command('M', point);
+    pen_position_ = point;
+}
+
+void GpglWriter::draw_to(const Vector& point) {
+    command_count_++;
+    if (!simplify_tolerance_ || !pen_position_) {
+        write_command('D', point);
+        pen_position_ = point;
+        return;
+    }
+
+    if (*pen_position_ == point) {
+        eliminated_command_count_++;
+        return;
+    }
+
+    if (run_.empty()) {
+        run_.push_back(*pen_position_);
+    }
+
+    if (extends_run(point)) {
+        // The pending draw is replaced by the draw to the new point.
+        eliminated_command_count_++;
+    } else {
+        flush_run();
+    }
+
+    run_.push_back(point);
+    pen_position_ = point;
+}
+
+void GpglWriter::end_shape() {
+    flush_run();
+    sink_.end_shape();
 }
 
+void GpglWriter::write_polyline(const Polyline& polyline) {
+    if (polyline.empty()) {
+        return;
+    }
+
+    move_to(polyline.front());
+    for (auto iter = std::next(polyline.begin()); iter != polyline.end();
+         ++iter) {
+        draw_to(*iter);
+    }
+
+    end_shape();
+}
+
+GpglExporter::GpglExporter(GpglWriter& writer,
+                           const FlatteningTolerance& tolerance,
+                           PenTravelOptimizer* optimizer)
+    : writer_{writer}, tolerance_{tolerance}, optimizer_{optimizer} {}
+
 void GpglExporter::plot(const DashedPath& path) {
-    path.to_polylines([this](Vector start_point) {
-        start_point = to_gpgl(start_point);
-        out_stream_.get() << "M " << start_point(0) << ',' << start_point(1)
-                          << '\x03';
-        return [this](Vector point) {
-            point = to_gpgl(point);
-            out_stream_.get() << "D " << point(0) << ',' << point(1) << '\x03';
-        };
+    if (optimizer_ != nullptr) {
+        Polyline polyline;
+        path.to_polylines(tolerance_, [this, &polyline](Vector start_point) {
+            if (!polyline.empty()) {
+                optimizer_->add(std::move(polyline));
+            }
+
+            polyline = {to_gpgl(start_point)};
+            return [&polyline](Vector point) {
+                polyline.push_back(to_gpgl(point));
+            };
+        });
+
+        if (!polyline.empty()) {
+            optimizer_->add(std::move(polyline));
+        }
+
+        return;
+    }
+
+    GpglWriter& writer = writer_.get();
+    path.to_polylines(tolerance_, [&writer](Vector start_point) {
+        writer.move_to(to_gpgl(start_point));
+        return [&writer](Vector point) { writer.draw_to(to_gpgl(point)); };
     });
+
+    writer.end_shape();
 }
@@ -1,28 +1,163 @@
 #ifndef SVG_CONVERTER_PARSING_GPGL_EXPORTER_H_
 #define SVG_CONVERTER_PARSING_GPGL_EXPORTER_H_
 
+#include <cstddef>
 #include <functional>
-#include <sstream>
+#include <vector>
 
+#include <boost/optional.hpp>
+
+#include "../bezier.h"
 #include "../math_defs.h"
+#include "../output_sink.h"
+#include "../pen_travel.h"
 #include "dashes.h"
 
+/**
+ * Converts a tolerance in GPGL units into a tolerance for flattening paths.
+ *
+ * Paths are flattened in millimeters. The resolution of GPGL is used as the
+ * minimum segment length, and the maximum error is never smaller than half a
+ * GPGL unit, because rounding to GPGL units can introduce as much error
+ * anyway.
+ */
+FlatteningTolerance gpgl_flattening_tolerance(double gpgl_tolerance);
+
+/**
+ * Writes GPGL commands to an output sink.
+ *
+ * Optionally simplifies the commands after they have been rounded to GPGL
+ * units: Moves and draws to the current pen position are dropped, and runs of
+ * draws that lie on a straight line (within a tolerance) are merged into a
+ * single draw. Quantised curves, tiny dashes and clipped pattern lines
+ * produce lots of these.
+ *
+ * Not copyable, because it tracks the pen position over all written commands.
+ */
+class GpglWriter {
+ private:
+    OutputSink& sink_;
+
+    /**
+     * Maximum distance of merged points from the resulting line, in GPGL
+     * units. None if commands should not be simplified.
+     */
+    boost::optional<double> simplify_tolerance_;
+
+    /**
+     * Position of the pen after all commands passed so far.
+     *
+     * None before the first command.
+     */
+    boost::optional<Vector> pen_position_ = boost::none;
+
+    /**
+     * Points of the current run of draws, which might be merged.
+     *
+     * The first point is the already written start of the run, the last point
+     * is the target of a draw that has not been written yet. All points in
+     * between have been merged away.
+     */
+    std::vector<Vector> run_;
+
+    std::size_t command_count_ = 0;
+    std::size_t eliminated_command_count_ = 0;
+
+    void write_command(char command, const Vector& point);
+
+    /**
+     * Whether the current run can be extended by a draw to the point.
+     */
+    bool extends_run(const Vector& point) const;
+
+    /**
+     * Writes the pending draw of the current run, if any.
+     */
+    void flush_run();
+
+ public:
+    /**
+     * Creates a new writer.
+     *
+     * @param sink Sink to write to. Must be valid for the lifetime of the
+     *             writer.
+     * @param simplify_tolerance Tolerance in GPGL units for merging draws on a
+     *                           straight line. None to disable simplification.
+     */
+    explicit GpglWriter(
+        OutputSink& sink,
+        boost::optional<double> simplify_tolerance = boost::none);
+
+    GpglWriter(const GpglWriter&) = delete;
+    GpglWriter& operator=(const GpglWriter&) = delete;
+
+    /**
+     * Moves the pen up to a point (given in rounded GPGL units).
+     */
+    void move_to(const Vector& point);
+
+    /**
+     * Draws a line to a point (given in rounded GPGL units).
+     */
+    void draw_to(const Vector& point);
+
+    /**
+     * Writes all pending commands and marks the end of a shape in the sink.
+     */
+    void end_shape();
+
+    /**
+     * Writes a polyline (in rounded GPGL units) as a shape of its own.
+     */
+    void write_polyline(const Polyline& polyline);
+
+    /**
+     * Number of commands passed to the writer.
+     */
+    std::size_t command_count() const { return command_count_; }
+
+    /**
+     * Number of commands dropped or merged by simplification.
+     */
+    std::size_t eliminated_command_count() const {
+        return eliminated_command_count_;
+    }
+};
+
 class GpglExporter {
  private:
     // Reference wrapper to make the reference copyable.
-    std::reference_wrapper<std::ostringstream> out_stream_;
+    std::reference_wrapper<GpglWriter> writer_;
+
+    /**
+     * Tolerance for flattening exported paths, in millimeters.
+     */
+    FlatteningTolerance tolerance_;
+
+    /**
+     * Optimizer to pass polylines (in GPGL units) to instead of writing them
+     * directly, may be null.
+     */
+    PenTravelOptimizer* optimizer_;
 
  public:
     /**
-     * Creates a new gpgl exporter writing to the given stream.
+     * Creates a new gpgl exporter writing to the given writer.
+     *
+     * The writer and optimizer must be valid for the lifetime of the exporter
+     * and all its copies.
      *
-     * The reference must be valid for the lifetime of the exporter and all its
-     * copies.
+     * @param optimizer Optimizer for reordering the polylines before they are
+     *                  written, null to write them in document order.
      */
-    explicit GpglExporter(std::ostringstream& out_stream);
+    GpglExporter(GpglWriter& writer, const FlatteningTolerance& tolerance,
+                 PenTravelOptimizer* optimizer = nullptr);
 
     /**
      * Export the given dashed path.
+     *
+     * Marks the end of a shape afterwards, unless the path is passed to an
+     * optimizer.
      */
     void plot(const DashedPath& path);
 };
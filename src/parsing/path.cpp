@@ -1,46 +1,151 @@
 #include "path.h"
 
-#include <algorithm>
+#include "../transform_points.h"
 
 const char* InvalidPathError::what() const noexcept {
     return "Path does not start with a move command";
 }
 
-MoveCommand detail::transformed(MoveCommand command,
-                                const Transform& transform) {
-    return {transform * command.target};
+bool operator==(const FlatteningTolerance& lhs,
+                const FlatteningTolerance& rhs) {
+    return lhs.max_error == rhs.max_error &&
+           lhs.min_segment_length == rhs.min_segment_length;
 }
 
-LineCommand detail::transformed(LineCommand command,
-                                const Transform& transform) {
-    return {transform * command.target};
+void Path::invalidate_flattening() {
+    flattened_.reset();
+    last_tolerance_ = boost::none;
 }
 
-BezierCommand detail::transformed(BezierCommand command,
-                                  const Transform& transform) {
-    // Affine transformations can be applied to bezier curves by just applying
-    // them to the control points (see http://math.stackexchange.com/a/1327062).
-    return {transform * command.target, transform * command.control_point_1,
-            transform * command.control_point_2};
+const FlattenedPath* Path::begin_flattening(
+    const FlatteningTolerance& tolerance) const {
+    if (flattened_ && flattened_->tolerance() == tolerance) {
+        count_stat(StatsCounter::kReusedFlattenings);
+        return flattened_.get();
+    }
+
+    count_stat(StatsCounter::kPathsFlattened);
+    if (last_tolerance_ && *last_tolerance_ == tolerance) {
+        count_stat(StatsCounter::kRedundantFlattenings);
+    }
+
+    last_tolerance_ = tolerance;
+    return nullptr;
+}
+
+const FlattenedPath& Path::flattened(
+    const FlatteningTolerance& tolerance) const {
+    if (const FlattenedPath* flattened = begin_flattening(tolerance)) {
+        return *flattened;
+    }
+
+    auto flattening = std::make_shared<FlattenedPath>(tolerance);
+    auto factory = [&flattening](Vector start_point) {
+        flattening->start_polyline(start_point);
+        return [&flattening](Vector point) { flattening->add_point(point); };
+    };
+    flatten(tolerance, factory);
+    flattened_ = std::move(flattening);
+    return *flattened_;
 }
 
-CloseSubpathCommand detail::transformed(CloseSubpathCommand command,
-                                        const Transform& /*unused*/) {
-    return command;
+const Vector& Path::current_position() const {
+    if (verbs_.back() == PathVerb::kClose) {
+        return points_[subpath_start_];
+    }
+
+    return points_.back();
 }
 
-void Path::push_command(const PathCommand& command) {
-    commands_.push_back(command);
+void Path::compute_bounding_box() {
+    bounding_box_.setEmpty();
+    const Vector* point = points_.data();
+    const Vector* subpath_start = point;
+    const Vector* current_position = point;
+    for (PathVerb verb : verbs_) {
+        switch (verb) {
+            case PathVerb::kMove:
+                subpath_start = point;
+                current_position = point++;
+                break;
+            case PathVerb::kLine:
+                bounding_box_.extend(*current_position);
+                bounding_box_.extend(*point);
+                current_position = point++;
+                break;
+            case PathVerb::kBezier:
+                bounding_box_.extend(curve_bounds(*current_position, point[0],
+                                                  point[1], point[2]));
+                current_position = point + 2;
+                point += 3;
+                break;
+            case PathVerb::kClose:
+                current_position = subpath_start;
+                break;
+        }
+    }
+}
+
+void Path::push_command(const MoveCommand& command) {
+    invalidate_flattening();
+    subpath_start_ = points_.size();
+    verbs_.push_back(PathVerb::kMove);
+    points_.push_back(command.target);
+}
+
+void Path::push_command(const LineCommand& command) {
+    invalidate_flattening();
+    // The start is already in the box, unless it's the target of a move
+    if (!points_.empty()) {
+        bounding_box_.extend(current_position());
+    }
+    bounding_box_.extend(command.target);
+    verbs_.push_back(PathVerb::kLine);
+    points_.push_back(command.target);
+}
+
+void Path::push_command(const BezierCommand& command) {
+    invalidate_flattening();
+    if (!points_.empty()) {
+        bounding_box_.extend(
+            curve_bounds(current_position(), command.control_point_1,
+                         command.control_point_2, command.target));
+    }
+    verbs_.push_back(PathVerb::kBezier);
+    points_.push_back(command.control_point_1);
+    points_.push_back(command.control_point_2);
+    points_.push_back(command.target);
+}
+
+void Path::push_command(const CloseSubpathCommand& /*unused*/) {
+    invalidate_flattening();
+    verbs_.push_back(PathVerb::kClose);
+}
+
+void Path::reserve(std::size_t commands, std::size_t points) {
+    verbs_.reserve(commands);
+    points_.reserve(points);
 }
 
 void Path::transform(const Transform& transform) {
-    std::transform(
-        std::begin(commands_), std::end(commands_), std::begin(commands_),
-        [transform](const PathCommand& command) {
-            return boost::apply_visitor(
-                [transform](auto&& cmd) {
-                    return PathCommand{detail::transformed(cmd, transform)};
-                },
-                command);
-        });
+    // Affine transformations can be applied to bezier curves by just applying
+    // them to the control points (see http://math.stackexchange.com/a/1327062),
+    // so all points are transformed alike.
+    invalidate_flattening();
+    transform_points(transform, points_.data(), points_.size());
+
+    // Scales and translations map the box to the box of the transformed
+    // path. Rotations and shears move the extremes of curves, so the box has
+    // to be computed again.
+    const auto& linear = transform.linear();
+    if (linear(0, 1) == 0 && linear(1, 0) == 0) {
+        if (!bounding_box_.isEmpty()) {
+            Vector corner_1 = transform * bounding_box_.min();
+            Vector corner_2 = transform * bounding_box_.max();
+            bounding_box_ = Rect{corner_1.cwiseMin(corner_2),
+                                 corner_1.cwiseMax(corner_2)};
+        }
+    } else {
+        compute_bounding_box();
+    }
 }
@@ -1,27 +1,19 @@
 #ifndef SVG_CONVERTER_PARSING_PATH_H
 #define SVG_CONVERTER_PARSING_PATH_H
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <stdexcept>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
 #include <boost/optional.hpp>
-#include <boost/variant.hpp>
 
 #include "../bezier.h"
 #include "../math_defs.h"
-
-namespace detail {
-
-/**
- * Error threshold for bezier subdivision.
- *
- * See `subdivide_curve` in `bezier.h` for details.
- */
-constexpr double kBezierErrorThreshold = 5;
-
-}  // namespace detail
+#include "../stats.h"
 
 struct InvalidPathError : std::exception {
     const char* what() const noexcept override;
@@ -44,115 +36,125 @@ struct BezierCommand {
 struct CloseSubpathCommand {};
 
 /**
- * Tagged enum over the possible commands in a path.
+ * Kind of a command in a path.
  *
  * These are reduced to a minimum based on the SVG++ path policy defined in
  * `traversal.h`.
  */
-using PathCommand = boost::variant<MoveCommand, LineCommand, BezierCommand,
-                                   CloseSubpathCommand>;
-
-namespace detail {
+enum class PathVerb : std::uint8_t { kMove, kLine, kBezier, kClose };
 
 /**
- * Command visitor used to implement `Path::to_polylines`.
+ * Polylines a path has been flattened to, see `Path::flattened`.
  */
-template <class PolylineVisitorFactory>
-class PathToPolylineVisitor : public boost::static_visitor<> {
+class FlattenedPath {
  private:
-    using PolylineVisitor = std::result_of_t<PolylineVisitorFactory(Vector)>;
-
-    struct SubpathState {
-        PolylineVisitor visitor;
-        Vector starting_point;
-    };
-
-    PolylineVisitorFactory visitor_factory_;
-    Vector current_position_;
+    FlatteningTolerance tolerance_;
+    std::vector<Vector> points_;
 
     /**
-     * State concerning the subpath currently being converted.
-     *
-     * None if not currently in a subpath.
+     * Index of the first point of each polyline in `points_`.
      */
-    boost::optional<SubpathState> subpath_state_ = boost::none;
-
-    SubpathState& assert_in_subpath();
+    std::vector<std::size_t> polyline_starts_;
 
  public:
-    PathToPolylineVisitor(Vector start_position,
-                          PolylineVisitorFactory polyline_visitor_factory);
+    explicit FlattenedPath(const FlatteningTolerance& tolerance)
+        : tolerance_{tolerance} {}
 
-    void operator()(const MoveCommand& command);
-    void operator()(const LineCommand& command);
-    void operator()(const BezierCommand& command);
-    void operator()(const CloseSubpathCommand& command);
-};
-
-template <class PolylineVisitorFactory>
-PathToPolylineVisitor<PolylineVisitorFactory>::PathToPolylineVisitor(
-    Vector start_position, PolylineVisitorFactory polyline_visitor_factory)
-    : visitor_factory_{polyline_visitor_factory},
-      current_position_{std::move(start_position)} {}
+    const FlatteningTolerance& tolerance() const { return tolerance_; }
 
-template <class PolylineVisitorFactory>
-typename PathToPolylineVisitor<PolylineVisitorFactory>::SubpathState&
-PathToPolylineVisitor<PolylineVisitorFactory>::assert_in_subpath() {
-    if (!subpath_state_) {
-        PolylineVisitor visitor = visitor_factory_(current_position_);
-        // This weird construction is necessary to allow move only point
-        // callbacks. All tries to use the = operator resulted in the compiler
-        // trying to call a deleted copy assignment operator and not the move
-        // assignment operator.
-        subpath_state_.emplace(
-            SubpathState{std::move(visitor), current_position_});
+    void start_polyline(const Vector& start_point) {
+        polyline_starts_.push_back(points_.size());
+        points_.push_back(start_point);
     }
 
-    return *subpath_state_;
-}
+    void add_point(const Vector& point) { points_.push_back(point); }
 
-template <class PolylineVisitorFactory>
-void PathToPolylineVisitor<PolylineVisitorFactory>::operator()(
-    const MoveCommand& command) {
-    current_position_ = command.target;
-    subpath_state_ = boost::none;
-}
+    /**
+     * Visits the polylines like `Path::to_polylines`.
+     */
+    template <class PolylineVisitorFactory>
+    void to_polylines(PolylineVisitorFactory& polyline_visitor_factory) const;
+};
 
 template <class PolylineVisitorFactory>
-void PathToPolylineVisitor<PolylineVisitorFactory>::operator()(
-    const LineCommand& command) {
-    SubpathState& subpath_state = assert_in_subpath();
-    subpath_state.visitor(command.target);
-    current_position_ = command.target;
+void FlattenedPath::to_polylines(
+    PolylineVisitorFactory& polyline_visitor_factory) const {
+    for (std::size_t i = 0; i < polyline_starts_.size(); i++) {
+        std::size_t begin = polyline_starts_[i];
+        std::size_t end = i + 1 < polyline_starts_.size()
+                              ? polyline_starts_[i + 1]
+                              : points_.size();
+        auto visitor = polyline_visitor_factory(points_[begin]);
+        for (std::size_t j = begin + 1; j < end; j++) {
+            visitor(points_[j]);
+        }
+    }
 }
 
-template <class PolylineVisitorFactory>
-void PathToPolylineVisitor<PolylineVisitorFactory>::operator()(
-    const BezierCommand& command) {
-    SubpathState& subpath_state = assert_in_subpath();
-    subdivide_curve(
-        kBezierErrorThreshold, current_position_, command.control_point_1,
-        command.control_point_2, command.target,
-        [&subpath_state](Vector point) { subpath_state.visitor(point); });
-    current_position_ = command.target;
-}
+namespace detail {
 
+/**
+ * Tracks the polyline of the current subpath for `Path::to_polylines`.
+ */
 template <class PolylineVisitorFactory>
-void PathToPolylineVisitor<PolylineVisitorFactory>::operator()(
-    const CloseSubpathCommand& /*unused*/) {
-    subpath_state_->visitor(subpath_state_->starting_point);
-    current_position_ = subpath_state_->starting_point;
-    subpath_state_ = boost::none;
-}
+class SubpathPolyline {
+ private:
+    using PolylineVisitor = std::result_of_t<PolylineVisitorFactory(Vector)>;
 
-MoveCommand transformed(MoveCommand command, const Transform& transform);
+    struct State {
+        PolylineVisitor visitor;
+        Vector starting_point;
+    };
 
-LineCommand transformed(LineCommand command, const Transform& transform);
+    PolylineVisitorFactory& visitor_factory_;
 
-BezierCommand transformed(BezierCommand command, const Transform& transform);
+    /**
+     * None if not currently in a subpath.
+     */
+    boost::optional<State> state_ = boost::none;
 
-CloseSubpathCommand transformed(CloseSubpathCommand command,
-                                const Transform& /*unused*/);
+ public:
+    explicit SubpathPolyline(PolylineVisitorFactory& visitor_factory)
+        : visitor_factory_{visitor_factory} {}
+
+    /**
+     * Visitor of the current subpath, starting one at the given position if
+     * not in a subpath.
+     */
+    PolylineVisitor& visitor(const Vector& current_position) {
+        if (!state_) {
+            // This weird construction is necessary to allow move only point
+            // callbacks. All tries to use the = operator resulted in the
+            // compiler trying to call a deleted copy assignment operator and
+            // not the move assignment operator.
+            state_.emplace(
+                State{visitor_factory_(current_position), current_position});
+        }
+
+        return state_->visitor;
+    }
+
+    /**
+     * Closes the current subpath, if any, by a line back to its start.
+     *
+     * @return Start of the closed subpath, none if not in a subpath.
+     */
+    boost::optional<Vector> close() {
+        if (!state_) {
+            return boost::none;
+        }
+
+        Vector starting_point = state_->starting_point;
+        state_->visitor(starting_point);
+        state_ = boost::none;
+        return starting_point;
+    }
+
+    /**
+     * Ends the current subpath, if any, without closing it.
+     */
+    void end() { state_ = boost::none; }
+};
 
 }  // namespace detail
 
@@ -160,25 +162,110 @@ CloseSubpathCommand transformed(CloseSubpathCommand command,
  * An SVG path.
  *
  * Consists of several subpaths seperated by Move or SubpathClose commands.
+ *
+ * Stored as one byte per command and a single array with the points of all
+ * commands, in command order: Moves and lines have their target, bezier
+ * curves their two control points followed by their target, closes have no
+ * points. Compared to an array of variants, each of which is as large as a
+ * bezier curve, this is about a third of the size for paths made of lines,
+ * and transforms become a loop over contiguous points.
  */
 class Path {
  private:
-    std::vector<PathCommand> commands_;
+    std::vector<PathVerb> verbs_;
+    std::vector<Vector> points_;
+
+    /**
+     * Exact bounding box of the drawn parts of the path, kept up to date by
+     * `push_command`.
+     */
+    Rect bounding_box_;
+
+    /**
+     * Index of the target of the last move in `points_`, where a segment
+     * after a close starts.
+     */
+    std::size_t subpath_start_ = 0;
+
+    /**
+     * Memoised flattening, shared by copies of the path. Null if the path
+     * hasn't been memoised since it last changed.
+     */
+    mutable std::shared_ptr<const FlattenedPath> flattened_;
+
+    /**
+     * Tolerance of the last flattening since the path last changed, only
+     * used to count redundant flattenings.
+     */
+    mutable boost::optional<FlatteningTolerance> last_tolerance_;
+
+    /**
+     * Discards the memoised flattening after the path changed.
+     */
+    void invalidate_flattening();
+
+    /**
+     * Where a segment added next would start.
+     */
+    const Vector& current_position() const;
+
+    void compute_bounding_box();
+
+    /**
+     * Returns the memoised flattening for a tolerance, if any, and counts
+     * the flattening that is about to happen.
+     */
+    const FlattenedPath* begin_flattening(
+        const FlatteningTolerance& tolerance) const;
+
+    template <class PolylineVisitorFactory>
+    void flatten(const FlatteningTolerance& tolerance,
+                 PolylineVisitorFactory& polyline_visitor_factory) const;
 
  public:
     /**
      * Extends the path by adding a command at the end.
      */
-    void push_command(const PathCommand& command);
+    void push_command(const MoveCommand& command);
+    void push_command(const LineCommand& command);
+    void push_command(const BezierCommand& command);
+    void push_command(const CloseSubpathCommand& command);
+
+    /**
+     * Reserves space for commands with the given number of points in total.
+     */
+    void reserve(std::size_t commands, std::size_t points);
 
     /**
      * Apply a transformation to all commands in a path.
      */
     void transform(const Transform& transform);
 
+    /**
+     * Exact bounding box of the drawn parts of the path.
+     *
+     * Computed from the commands, curves by their extremes, without
+     * flattening. Contains the polylines of any flattening of the path, but
+     * not moves that aren't followed by a line or curve. Empty if nothing is
+     * drawn.
+     */
+    const Rect& bounding_box() const { return bounding_box_; }
+
+    /**
+     * Flattens the path into polylines and memoises them, so that later
+     * calls of `to_polylines` with the same tolerance replay them instead of
+     * flattening the path again.
+     *
+     * Worthwhile for paths that are flattened more than once, like the
+     * outline of a pattern filled shape. Not thread safe, even though it is
+     * const. The memoised polylines are discarded whenever the path changes.
+     */
+    const FlattenedPath& flattened(const FlatteningTolerance& tolerance) const;
+
     /**
      * Convert a path to a series of polylines.
      *
+     * @param tolerance Tolerance for approximating curves by polylines.
      * @param polyline_visitor_factory Factory to create a visitor for a
      *                                 polyline. The factory will be called with
      *                                 the starting point as the only parameter.
@@ -188,25 +275,75 @@ class Path {
      *                                 the visitor will be destructed.
      */
     template <class PolylineVisitorFactory>
-    void to_polylines(PolylineVisitorFactory polyline_visitor_factory) const;
+    void to_polylines(const FlatteningTolerance& tolerance,
+                      PolylineVisitorFactory polyline_visitor_factory) const;
 };
 
 template <class PolylineVisitorFactory>
-void Path::to_polylines(PolylineVisitorFactory polyline_visitor_factory) const {
-    if (commands_.empty()) {
+void Path::to_polylines(const FlatteningTolerance& tolerance,
+                        PolylineVisitorFactory polyline_visitor_factory) const {
+    if (const FlattenedPath* flattened = begin_flattening(tolerance)) {
+        flattened->to_polylines(polyline_visitor_factory);
+        return;
+    }
+
+    flatten(tolerance, polyline_visitor_factory);
+}
+
+template <class PolylineVisitorFactory>
+void Path::flatten(const FlatteningTolerance& tolerance,
+                   PolylineVisitorFactory& polyline_visitor_factory) const {
+    if (verbs_.empty()) {
         return;
     }
 
-    auto* move_cmd_ptr = boost::get<MoveCommand>(&commands_.front());
-    if (move_cmd_ptr == nullptr) {
+    if (verbs_.front() != PathVerb::kMove) {
         throw InvalidPathError{};
     }
 
-    detail::PathToPolylineVisitor<PolylineVisitorFactory> command_visitor{
-        move_cmd_ptr->target, polyline_visitor_factory};
-    for (const auto& command : commands_) {
-        boost::apply_visitor(command_visitor, command);
+    ScopedPhase phase{StatsPhase::kFlattening};
+    std::size_t point_count = 0;
+    std::size_t segment_count = 0;
+
+    detail::SubpathPolyline<PolylineVisitorFactory> subpath{
+        polyline_visitor_factory};
+    Vector current_position = points_.front();
+    const Vector* point = points_.data();
+    for (PathVerb verb : verbs_) {
+        switch (verb) {
+            case PathVerb::kMove:
+                subpath.end();
+                current_position = *point++;
+                break;
+            case PathVerb::kLine:
+                subpath.visitor(current_position)(*point);
+                point_count++;
+                current_position = *point++;
+                break;
+            case PathVerb::kBezier: {
+                auto& visitor = subpath.visitor(current_position);
+                std::size_t segments = curve_segment_count(
+                    tolerance, current_position, point[0], point[1], point[2]);
+                flatten_curve(segments, current_position, point[0], point[1],
+                              point[2],
+                              [&visitor](Vector target) { visitor(target); });
+                segment_count += segments;
+                point_count += segments;
+                current_position = point[2];
+                point += 3;
+                break;
+            }
+            case PathVerb::kClose:
+                if (auto starting_point = subpath.close()) {
+                    current_position = *starting_point;
+                    point_count++;
+                }
+                break;
+        }
     }
+
+    count_stat(StatsCounter::kBezierSegments, segment_count);
+    count_stat(StatsCounter::kPointsGenerated, point_count);
 }
 
 #endif  // SVG_CONVERTER_PARSING_PATH_H
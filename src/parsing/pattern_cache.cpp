@@ -0,0 +1,44 @@
+#include "pattern_cache.h"
+
+#include <utility>
+
+#include <boost/functional/hash.hpp>
+
+bool PatternCacheKey::operator==(const PatternCacheKey& other) const {
+    // Exact comparisons are intended, a cache hit must produce exactly the
+    // same output as traversing the pattern again.
+    return id == other.id && to_root.matrix() == other.to_root.matrix() &&
+           viewport_size == other.viewport_size &&
+           bbox_size == other.bbox_size;
+}
+
+std::size_t detail::PatternCacheKeyHash::operator()(
+    const PatternCacheKey& key) const {
+    std::size_t seed = 0;
+    boost::hash_combine(seed, key.id);
+    for (Eigen::Index i = 0; i < key.to_root.matrix().size(); i++) {
+        boost::hash_combine(seed, key.to_root.matrix()(i));
+    }
+    boost::hash_combine(seed, key.viewport_size.x());
+    boost::hash_combine(seed, key.viewport_size.y());
+    boost::hash_combine(seed, key.bbox_size.x());
+    boost::hash_combine(seed, key.bbox_size.y());
+    return seed;
+}
+
+const std::vector<DashedPath>* PatternCache::find(const PatternCacheKey& key) {
+    auto iter = entries_.find(key);
+    if (iter == entries_.end()) {
+        misses_++;
+        return nullptr;
+    }
+
+    hits_++;
+    return &iter->second;
+}
+
+const std::vector<DashedPath>& PatternCache::insert(
+    PatternCacheKey key, std::vector<DashedPath> paths) {
+    // References to elements of an unordered_map stay valid on insertion.
+    return entries_.emplace(std::move(key), std::move(paths)).first->second;
+}
@@ -0,0 +1,99 @@
+#ifndef SVG_CONVERTER_PARSING_PATTERN_CACHE_H_
+#define SVG_CONVERTER_PARSING_PATTERN_CACHE_H_
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../math_defs.h"
+#include "dashes.h"
+
+/**
+ * Identifies one layout of a <pattern> element.
+ *
+ * The paths generated by a pattern only depend on the pattern element itself
+ * and on these inputs, so two references with equal keys produce the same
+ * paths.
+ */
+struct PatternCacheKey {
+    /**
+     * Value of the `id` attribute of the pattern.
+     */
+    std::string id;
+
+    /**
+     * Transform to the root coordinate system of the referencing shape.
+     */
+    Transform to_root;
+
+    /**
+     * Size of the viewport used to resolve percentages.
+     */
+    Vector viewport_size;
+
+    /**
+     * Size of the bounding box of the referencing shape.
+     *
+     * Only relevant if patternUnits or patternContentUnits is set to
+     * objectBoundingBox, zero otherwise, so that shapes of different size can
+     * share the cached paths.
+     */
+    Vector bbox_size;
+
+    bool operator==(const PatternCacheKey& other) const;
+};
+
+namespace detail {
+
+struct PatternCacheKeyHash {
+    std::size_t operator()(const PatternCacheKey& key) const;
+};
+
+}  // namespace detail
+
+/**
+ * Caches the paths generated by <pattern> elements for a single document.
+ *
+ * Without the cache, a pattern is traversed again for every shape that
+ * references it (including all nested patterns).
+ */
+class PatternCache {
+ private:
+    std::unordered_map<PatternCacheKey, std::vector<DashedPath>,
+                       detail::PatternCacheKeyHash>
+        entries_;
+
+    std::size_t hits_ = 0;
+    std::size_t misses_ = 0;
+
+ public:
+    /**
+     * Looks up the paths for the given key.
+     *
+     * @return Pointer to the cached paths, valid for the lifetime of the
+     *         cache. Null if the key is not cached yet.
+     */
+    const std::vector<DashedPath>* find(const PatternCacheKey& key);
+
+    /**
+     * Stores the paths generated for the given key.
+     *
+     * @return Reference to the stored paths, valid for the lifetime of the
+     *         cache.
+     */
+    const std::vector<DashedPath>& insert(PatternCacheKey key,
+                                          std::vector<DashedPath> paths);
+
+    /**
+     * Number of lookups that found cached paths.
+     */
+    std::size_t hits() const { return hits_; }
+
+    /**
+     * Number of lookups that did not find cached paths.
+     */
+    std::size_t misses() const { return misses_; }
+};
+
+#endif  // SVG_CONVERTER_PARSING_PATTERN_CACHE_H_
@@ -82,6 +82,9 @@ using ProcessedAttributes = Concat<
     // Enable transform attributes for all elements
     mpl::set<attrib::transform, attrib::patternTransform>,
 
+    // Enable ids for all elements, to label them in traces
+    mpl::set<attrib::id>,
+
     // Enable unit attributes for patterns
     PatternUnitAttributes>;
 
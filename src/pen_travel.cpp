@@ -0,0 +1,380 @@
+#include "pen_travel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include <boost/optional.hpp>
+
+/**
+ * Number of greedy steps or 2-opt positions between checks of the deadline.
+ */
+constexpr std::size_t kDeadlineCheckInterval = 256;
+
+/**
+ * Minimum improvement for a 2-opt move to be applied.
+ *
+ * Avoids endless loops due to rounding errors.
+ */
+constexpr double kMinTwoOptImprovement = 1e-9;
+
+Vector start_point(const Polyline& polyline, bool reversed) {
+    return reversed ? polyline.back() : polyline.front();
+}
+
+Vector end_point(const Polyline& polyline, bool reversed) {
+    return reversed ? polyline.front() : polyline.back();
+}
+
+/**
+ * Uniform grid over the endpoints of polylines for nearest neighbour queries.
+ *
+ * Endpoint `2 * i` is the front of polyline `i`, endpoint `2 * i + 1` its
+ * back. Taking a polyline removes both of its endpoints.
+ */
+class EndpointGrid {
+ private:
+    const std::vector<Polyline>& polylines_;
+    bool with_backs_;
+
+    Vector origin_;
+    double cell_size_;
+    long columns_;
+    long rows_;
+
+    /**
+     * Endpoints sorted by cell. Cell `c` holds the entries
+     * `[cell_begin_[c], cell_begin_[c] + cell_count_[c])`.
+     */
+    std::vector<std::size_t> entries_;
+    std::vector<std::size_t> cell_begin_;
+    std::vector<std::size_t> cell_count_;
+
+    /**
+     * Position of each endpoint in `entries_`.
+     */
+    std::vector<std::size_t> positions_;
+
+    Vector endpoint(std::size_t id) const {
+        const Polyline& polyline = polylines_[id / 2];
+        return id % 2 == 0 ? polyline.front() : polyline.back();
+    }
+
+    long clamp_column(double x) const {
+        auto column =
+            static_cast<long>(std::floor((x - origin_.x()) / cell_size_));
+        return std::min(std::max(column, 0L), columns_ - 1);
+    }
+
+    long clamp_row(double y) const {
+        auto row =
+            static_cast<long>(std::floor((y - origin_.y()) / cell_size_));
+        return std::min(std::max(row, 0L), rows_ - 1);
+    }
+
+    std::size_t cell_of(const Vector& point) const {
+        return static_cast<std::size_t>(clamp_row(point.y()) * columns_ +
+                                        clamp_column(point.x()));
+    }
+
+    void remove(std::size_t id) {
+        std::size_t cell = cell_of(endpoint(id));
+        std::size_t last = cell_begin_[cell] + --cell_count_[cell];
+        std::size_t position = positions_[id];
+        std::swap(entries_[position], entries_[last]);
+        positions_[entries_[position]] = position;
+        positions_[entries_[last]] = last;
+    }
+
+ public:
+    EndpointGrid(const std::vector<Polyline>& polylines, bool with_backs)
+        : polylines_{polylines}, with_backs_{with_backs} {
+        Rect bounds;
+        for (const Polyline& polyline : polylines) {
+            bounds.extend(polyline.front());
+            bounds.extend(polyline.back());
+        }
+
+        // About one polyline per cell. The second bound keeps the number of
+        // cells linear for very flat bounds.
+        Vector size = bounds.sizes();
+        double area = std::max(size.x(), 1.0) * std::max(size.y(), 1.0);
+        auto count = static_cast<double>(polylines.size() + 1);
+        cell_size_ = std::max(std::sqrt(area / count),
+                              std::max(size.maxCoeff(), 1.0) / count);
+        origin_ = bounds.min();
+        columns_ = static_cast<long>(size.x() / cell_size_) + 1;
+        rows_ = static_cast<long>(size.y() / cell_size_) + 1;
+
+        auto cell_count = static_cast<std::size_t>(columns_ * rows_);
+        cell_begin_.assign(cell_count + 1, 0);
+        cell_count_.assign(cell_count, 0);
+        positions_.assign(polylines.size() * 2, 0);
+        for (std::size_t id = 0; id < positions_.size(); id++) {
+            if (with_backs_ || id % 2 == 0) {
+                cell_count_[cell_of(endpoint(id))]++;
+            }
+        }
+
+        for (std::size_t cell = 0; cell < cell_count; cell++) {
+            cell_begin_[cell + 1] = cell_begin_[cell] + cell_count_[cell];
+        }
+
+        entries_.resize(cell_begin_.back());
+        std::fill(cell_count_.begin(), cell_count_.end(), 0);
+        for (std::size_t id = 0; id < positions_.size(); id++) {
+            if (with_backs_ || id % 2 == 0) {
+                std::size_t cell = cell_of(endpoint(id));
+                std::size_t position = cell_begin_[cell] + cell_count_[cell]++;
+                entries_[position] = id;
+                positions_[id] = position;
+            }
+        }
+    }
+
+    /**
+     * Removes both endpoints of a polyline.
+     */
+    void take(std::size_t polyline) {
+        remove(polyline * 2);
+        if (with_backs_) {
+            remove(polyline * 2 + 1);
+        }
+    }
+
+    /**
+     * Finds the endpoint closest to a point, none if the grid is empty.
+     */
+    boost::optional<std::size_t> nearest(const Vector& point) const {
+        long center_column = clamp_column(point.x());
+        long center_row = clamp_row(point.y());
+        long max_ring = std::max(columns_, rows_);
+
+        boost::optional<std::size_t> best;
+        double best_distance = std::numeric_limits<double>::infinity();
+        for (long ring = 0; ring <= max_ring; ring++) {
+            for (long row = center_row - ring; row <= center_row + ring;
+                 row++) {
+                if (row < 0 || row >= rows_) {
+                    continue;
+                }
+
+                // Only the outline of the ring, inner cells have been visited
+                bool full_row = row == center_row - ring ||
+                                row == center_row + ring;
+                long step = full_row ? 1 : std::max(2 * ring, 1L);
+                for (long column = center_column - ring;
+                     column <= center_column + ring; column += step) {
+                    if (column < 0 || column >= columns_) {
+                        continue;
+                    }
+
+                    auto cell =
+                        static_cast<std::size_t>(row * columns_ + column);
+                    std::size_t begin = cell_begin_[cell];
+                    std::size_t end = begin + cell_count_[cell];
+                    for (std::size_t i = begin; i < end; i++) {
+                        double distance =
+                            (endpoint(entries_[i]) - point).squaredNorm();
+                        if (distance < best_distance) {
+                            best_distance = distance;
+                            best = entries_[i];
+                        }
+                    }
+                }
+            }
+
+            // Points in the next ring are at least `ring` cells away
+            double min_next = static_cast<double>(ring) * cell_size_;
+            if (best && best_distance <= min_next * min_next) {
+                break;
+            }
+        }
+
+        return best;
+    }
+};
+
+double pen_up_distance(const std::vector<Polyline>& polylines,
+                       const std::vector<PlannedPolyline>& order,
+                       const Vector& start) {
+    double distance = 0;
+    Vector position = start;
+    for (const PlannedPolyline& planned : order) {
+        const Polyline& polyline = polylines[planned.index];
+        distance += (start_point(polyline, planned.reversed) - position).norm();
+        position = end_point(polyline, planned.reversed);
+    }
+
+    return distance;
+}
+
+/**
+ * Greedy nearest neighbour tour through the polylines.
+ */
+std::vector<PlannedPolyline> plan_greedy(
+    const std::vector<Polyline>& polylines, const Vector& start,
+    bool allow_reversal, std::chrono::steady_clock::time_point deadline) {
+    std::vector<PlannedPolyline> order;
+    order.reserve(polylines.size());
+    std::vector<bool> taken(polylines.size(), false);
+    EndpointGrid grid{polylines, allow_reversal};
+
+    Vector position = start;
+    while (order.size() < polylines.size()) {
+        if (order.size() % kDeadlineCheckInterval == 0 &&
+            std::chrono::steady_clock::now() > deadline) {
+            break;
+        }
+
+        std::size_t endpoint = *grid.nearest(position);
+        PlannedPolyline planned{endpoint / 2, endpoint % 2 == 1};
+        grid.take(planned.index);
+        taken[planned.index] = true;
+        order.push_back(planned);
+        position = end_point(polylines[planned.index], planned.reversed);
+    }
+
+    for (std::size_t i = 0; i < polylines.size(); i++) {
+        if (!taken[i]) {
+            order.push_back({i, false});
+        }
+    }
+
+    return order;
+}
+
+/**
+ * Improves a drawing order with 2-opt moves.
+ *
+ * A move reverses a range of polylines, including the direction of each of
+ * them. Pen-up travel inside the range stays the same, so only the two moves
+ * at its boundaries need to be compared.
+ */
+void refine_two_opt(const std::vector<Polyline>& polylines,
+                    const Vector& start, std::size_t window,
+                    std::chrono::steady_clock::time_point deadline,
+                    std::vector<PlannedPolyline>& order) {
+    auto start_of = [&](std::size_t i) {
+        return start_point(polylines[order[i].index], order[i].reversed);
+    };
+    auto end_of = [&](std::size_t i) {
+        return end_point(polylines[order[i].index], order[i].reversed);
+    };
+
+    bool improved = true;
+    while (improved) {
+        improved = false;
+        for (std::size_t i = 0; i < order.size(); i++) {
+            if (i % kDeadlineCheckInterval == 0 &&
+                std::chrono::steady_clock::now() > deadline) {
+                return;
+            }
+
+            Vector before = i == 0 ? start : end_of(i - 1);
+            std::size_t last = std::min(order.size(), i + window);
+            for (std::size_t j = i; j < last; j++) {
+                double old_distance = (start_of(i) - before).norm();
+                double new_distance = (end_of(j) - before).norm();
+                if (j + 1 < order.size()) {
+                    old_distance += (start_of(j + 1) - end_of(j)).norm();
+                    new_distance += (start_of(j + 1) - start_of(i)).norm();
+                }
+
+                if (new_distance < old_distance - kMinTwoOptImprovement) {
+                    std::reverse(order.begin() + static_cast<long>(i),
+                                 order.begin() + static_cast<long>(j + 1));
+                    for (std::size_t k = i; k <= j; k++) {
+                        order[k].reversed = !order[k].reversed;
+                    }
+
+                    improved = true;
+                }
+            }
+        }
+    }
+}
+
+std::vector<PlannedPolyline> plan_pen_travel(
+    const std::vector<Polyline>& polylines, const Vector& start,
+    const PenTravelOptions& options,
+    std::chrono::steady_clock::time_point deadline) {
+    if (polylines.empty()) {
+        return {};
+    }
+
+    std::vector<PlannedPolyline> order =
+        plan_greedy(polylines, start, options.allow_reversal, deadline);
+    if (options.allow_reversal && options.two_opt) {
+        refine_two_opt(polylines, start, options.two_opt_window, deadline,
+                       order);
+    }
+
+    return order;
+}
+
+PenTravelOptimizer::PenTravelOptimizer(EmitFunction emit,
+                                       const PenTravelOptions& options)
+    : emit_{std::move(emit)},
+      options_{options},
+      remaining_budget_{options.time_budget} {}
+
+void PenTravelOptimizer::add(Polyline polyline) {
+    if (polyline.size() < 2) {
+        return;
+    }
+
+    point_count_ += polyline.size();
+    polylines_.push_back(std::move(polyline));
+    if (point_count_ >= options_.window_points) {
+        flush();
+    }
+}
+
+void PenTravelOptimizer::flush() {
+    if (polylines_.empty()) {
+        return;
+    }
+
+    std::vector<PlannedPolyline> original_order;
+    original_order.reserve(polylines_.size());
+    for (std::size_t i = 0; i < polylines_.size(); i++) {
+        original_order.push_back({i, false});
+    }
+
+    double before = pen_up_distance(polylines_, original_order, pen_position_);
+    std::vector<PlannedPolyline> order;
+    double after = before;
+    // Non finite coordinates would break the grid, but also make the distance
+    // infinite or NaN
+    if (std::isfinite(before) && remaining_budget_.count() > 0) {
+        auto start = std::chrono::steady_clock::now();
+        order = plan_pen_travel(polylines_, pen_position_, options_,
+                                start + remaining_budget_);
+        after = pen_up_distance(polylines_, order, pen_position_);
+        remaining_budget_ -= std::chrono::steady_clock::now() - start;
+    }
+
+    // The greedy tour is not guaranteed to beat the original order
+    if (order.empty() || after > before) {
+        order = std::move(original_order);
+        after = before;
+    }
+
+    for (const PlannedPolyline& planned : order) {
+        Polyline& polyline = polylines_[planned.index];
+        if (planned.reversed) {
+            std::reverse(polyline.begin(), polyline.end());
+        }
+
+        emit_(polyline);
+    }
+
+    pen_position_ = end_point(polylines_[order.back().index], false);
+    emitted_count_ += polylines_.size();
+    pen_up_before_ += before;
+    pen_up_after_ += after;
+    polylines_.clear();
+    point_count_ = 0;
+}
@@ -0,0 +1,165 @@
+#ifndef SVG_CONVERTER_PEN_TRAVEL_H_
+#define SVG_CONVERTER_PEN_TRAVEL_H_
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "math_defs.h"
+
+using Polyline = std::vector<Vector>;
+
+/**
+ * Options for reordering polylines to reduce pen-up travel.
+ */
+struct PenTravelOptions {
+    /**
+     * Number of points collected before the collected polylines are reordered
+     * and emitted. Bounds memory usage and the cost of a single optimisation.
+     */
+    std::size_t window_points = 1 << 20;
+
+    /**
+     * Whether polylines may be drawn from back to front.
+     */
+    bool allow_reversal = true;
+
+    /**
+     * Whether to refine the greedy order with 2-opt moves.
+     *
+     * Only has an effect if reversal is allowed, because a 2-opt move reverses
+     * a whole range of polylines.
+     */
+    bool two_opt = true;
+
+    /**
+     * Maximum number of consecutive polylines reversed by a single 2-opt move.
+     */
+    std::size_t two_opt_window = 64;
+
+    /**
+     * Time that may be spent on optimisation for all polylines of an
+     * optimizer. Polylines are emitted in their original order once it is
+     * exhausted.
+     */
+    std::chrono::steady_clock::duration time_budget =
+        std::chrono::milliseconds{250};
+};
+
+/**
+ * A polyline in the drawing order created by `plan_pen_travel`.
+ */
+struct PlannedPolyline {
+    /**
+     * Index into the planned polylines.
+     */
+    std::size_t index;
+
+    /**
+     * Whether the polyline is drawn from back to front.
+     */
+    bool reversed;
+};
+
+/**
+ * Total distance travelled with the pen up to draw polylines in an order.
+ *
+ * @param start Position of the pen before the first polyline.
+ */
+double pen_up_distance(const std::vector<Polyline>& polylines,
+                       const std::vector<PlannedPolyline>& order,
+                       const Vector& start);
+
+/**
+ * Finds a drawing order with short pen-up travel.
+ *
+ * Starts with a greedy nearest neighbour tour, looking up the closest
+ * remaining endpoint in a uniform grid, and optionally refines it with 2-opt
+ * moves. Both stop when the deadline has passed, with unvisited polylines
+ * appended in their original order.
+ *
+ * All polylines must have at least one point.
+ *
+ * @param start Position of the pen before the first polyline.
+ */
+std::vector<PlannedPolyline> plan_pen_travel(
+    const std::vector<Polyline>& polylines, const Vector& start,
+    const PenTravelOptions& options,
+    std::chrono::steady_clock::time_point deadline);
+
+/**
+ * Collects polylines and emits them in an order with short pen-up travel.
+ *
+ * Polylines are collected until the window of the options is full or `flush`
+ * is called. Polylines with fewer than two points don't draw anything and are
+ * dropped.
+ */
+class PenTravelOptimizer {
+ public:
+    /**
+     * Function called for each polyline, in the optimised order.
+     */
+    using EmitFunction = std::function<void(const Polyline&)>;
+
+ private:
+    EmitFunction emit_;
+    PenTravelOptions options_;
+
+    /**
+     * Part of the time budget not yet spent on reordering.
+     */
+    std::chrono::steady_clock::duration remaining_budget_;
+
+    std::vector<Polyline> polylines_;
+    std::size_t point_count_ = 0;
+
+    /**
+     * End of the last emitted polyline. Plotters start at the origin.
+     */
+    Vector pen_position_ = Vector::Zero();
+
+    std::size_t emitted_count_ = 0;
+    double pen_up_before_ = 0;
+    double pen_up_after_ = 0;
+
+ public:
+    /**
+     * Creates a new optimizer.
+     *
+     * Only the time spent reordering in `flush` counts against the time
+     * budget of the options, not the time between flushes.
+     */
+    explicit PenTravelOptimizer(EmitFunction emit,
+                                const PenTravelOptions& options = {});
+
+    PenTravelOptimizer(const PenTravelOptimizer&) = delete;
+    PenTravelOptimizer& operator=(const PenTravelOptimizer&) = delete;
+
+    /**
+     * Adds a polyline, possibly emitting all collected polylines.
+     */
+    void add(Polyline polyline);
+
+    /**
+     * Emits all collected polylines.
+     */
+    void flush();
+
+    /**
+     * Number of emitted polylines.
+     */
+    std::size_t emitted_count() const { return emitted_count_; }
+
+    /**
+     * Pen-up distance of the emitted polylines in their original order.
+     */
+    double pen_up_distance_before() const { return pen_up_before_; }
+
+    /**
+     * Pen-up distance of the emitted polylines in the optimised order.
+     */
+    double pen_up_distance_after() const { return pen_up_after_; }
+};
+
+#endif  // SVG_CONVERTER_PEN_TRAVEL_H_
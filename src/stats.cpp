@@ -0,0 +1,93 @@
+#include "stats.h"
+
+#include <cstdio>
+
+/**
+ * Names of the counters in reports, in the order of `StatsCounter`.
+ */
+constexpr const char* kCounterNames[kStatsCounterCount] = {
+    "elements_visited",      "shapes",
+    "bezier_segments",       "points_generated",
+    "paths_flattened",       "redundant_flattenings",
+    "reused_flattenings",    "dashes",
+    "tiles",                 "clipper_input_points",
+    "clipper_output_points", "bytes_written"};
+
+/**
+ * Names of the phases in reports, in the order of `StatsPhase`.
+ */
+constexpr const char* kPhaseNames[kStatsPhaseCount] = {
+    "other",      "parse",  "id_index", "traversal",
+    "flattening", "tiling", "clipping", "output"};
+
+double to_milliseconds(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+Stats& Stats::operator+=(const Stats& other) {
+    for (std::size_t i = 0; i < kStatsCounterCount; i++) {
+        counters[i] += other.counters[i];
+    }
+
+    for (std::size_t i = 0; i < kStatsPhaseCount; i++) {
+        phase_times[i] += other.phase_times[i];
+    }
+
+    return *this;
+}
+
+Stats& Stats::operator-=(const Stats& other) {
+    for (std::size_t i = 0; i < kStatsCounterCount; i++) {
+        counters[i] -= other.counters[i];
+    }
+
+    for (std::size_t i = 0; i < kStatsPhaseCount; i++) {
+        phase_times[i] -= other.phase_times[i];
+    }
+
+    return *this;
+}
+
+Stats operator-(Stats lhs, const Stats& rhs) {
+    lhs -= rhs;
+    return lhs;
+}
+
+const char* stats_phase_name(StatsPhase phase) {
+    return kPhaseNames[static_cast<std::size_t>(phase)];
+}
+
+Stats current_thread_stats() {
+#if SVG_CONVERTER_STATS
+    // Attribute the time of the current phase up to now
+    detail::ThreadStats& thread_stats = detail::thread_stats();
+    thread_stats.switch_phase(thread_stats.phase);
+    return thread_stats.stats;
+#else
+    return {};
+#endif
+}
+
+void write_stats_json(std::ostream& out, const Stats& stats,
+                      std::chrono::steady_clock::duration wall_time,
+                      std::size_t files) {
+    // Only numbers and fixed names, so no escaping is needed
+    char number[32];
+    out << "{\"enabled\":" << (SVG_CONVERTER_STATS ? "true" : "false")
+        << ",\"files\":" << files;
+    std::snprintf(number, sizeof(number), "%.3f", to_milliseconds(wall_time));
+    out << ",\"wall_ms\":" << number << ",\"counters\":{";
+    for (std::size_t i = 0; i < kStatsCounterCount; i++) {
+        out << (i > 0 ? "," : "") << '"' << kCounterNames[i]
+            << "\":" << stats.counters[i];
+    }
+
+    out << "},\"phases_ms\":{";
+    for (std::size_t i = 0; i < kStatsPhaseCount; i++) {
+        std::snprintf(number, sizeof(number), "%.3f",
+                      to_milliseconds(stats.phase_times[i]));
+        out << (i > 0 ? "," : "") << '"' << kPhaseNames[i] << "\":" << number;
+    }
+
+    out << "}}\n";
+}
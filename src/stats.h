@@ -0,0 +1,228 @@
+#ifndef SVG_CONVERTER_STATS_H_
+#define SVG_CONVERTER_STATS_H_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+#include "trace.h"
+
+/**
+ * Events counted during a conversion.
+ */
+enum class StatsCounter {
+    /**
+     * Elements a context was created for, including referenced ones.
+     */
+    kElementsVisited,
+    kShapes,
+
+    /**
+     * Straight segments curves were flattened into.
+     */
+    kBezierSegments,
+
+    /**
+     * Points visited while flattening paths from their commands.
+     */
+    kPointsGenerated,
+
+    /**
+     * Flattenings of a path from its commands.
+     */
+    kPathsFlattened,
+
+    /**
+     * Flattenings repeating an earlier one of the same path with the same
+     * tolerance, which memoising would have avoided.
+     */
+    kRedundantFlattenings,
+
+    /**
+     * Flattenings replayed from memoised polylines.
+     */
+    kReusedFlattenings,
+
+    /**
+     * Line segments dashing reported, a dash spanning several segments of a
+     * polyline counts once per segment.
+     */
+    kDashes,
+    /**
+     * Pattern tiles overlapping a filled shape.
+     */
+    kTiles,
+    kClipperInputPoints,
+    kClipperOutputPoints,
+    kBytesWritten,
+    kCount
+};
+
+/**
+ * Phases of a conversion that time is attributed to.
+ *
+ * Phases nest, and each phase is only attributed the time not spent in a
+ * phase nested inside of it. Flattening includes what is done with each
+ * point, like formatting it as a GPGL command when exporting.
+ */
+enum class StatsPhase {
+    /**
+     * Time outside of all other phases.
+     */
+    kOther,
+
+    /**
+     * Reading and parsing XML.
+     */
+    kParse,
+    kIdIndex,
+    kTraversal,
+    kFlattening,
+    kTiling,
+    kClipping,
+
+    /**
+     * Passing output to the file or stdout.
+     */
+    kOutput,
+    kCount
+};
+
+constexpr std::size_t kStatsCounterCount =
+    static_cast<std::size_t>(StatsCounter::kCount);
+constexpr std::size_t kStatsPhaseCount =
+    static_cast<std::size_t>(StatsPhase::kCount);
+
+/**
+ * Counters and phase times, either of a thread or summed over threads.
+ */
+struct Stats {
+    std::array<std::uint64_t, kStatsCounterCount> counters{};
+    std::array<std::chrono::steady_clock::duration, kStatsPhaseCount>
+        phase_times{};
+
+    std::uint64_t& operator[](StatsCounter counter) {
+        return counters[static_cast<std::size_t>(counter)];
+    }
+
+    std::uint64_t operator[](StatsCounter counter) const {
+        return counters[static_cast<std::size_t>(counter)];
+    }
+
+    std::chrono::steady_clock::duration& operator[](StatsPhase phase) {
+        return phase_times[static_cast<std::size_t>(phase)];
+    }
+
+    Stats& operator+=(const Stats& other);
+    Stats& operator-=(const Stats& other);
+};
+
+Stats operator-(Stats lhs, const Stats& rhs);
+
+/**
+ * Name of a phase in reports and traces.
+ */
+const char* stats_phase_name(StatsPhase phase);
+
+namespace detail {
+
+/**
+ * Statistics of a thread, with the phase it is currently in.
+ */
+struct ThreadStats {
+    Stats stats;
+    StatsPhase phase = StatsPhase::kOther;
+    std::chrono::steady_clock::time_point phase_start =
+        std::chrono::steady_clock::now();
+
+    /**
+     * Attributes the time since the last switch to the current phase and
+     * switches to another one.
+     */
+    void switch_phase(StatsPhase next) {
+        auto now = std::chrono::steady_clock::now();
+        stats[phase] += now - phase_start;
+        phase_start = now;
+        phase = next;
+    }
+};
+
+inline ThreadStats& thread_stats() {
+    static thread_local ThreadStats stats;
+    return stats;
+}
+
+}  // namespace detail
+
+/**
+ * Adds to a counter of the current thread.
+ */
+inline void count_stat(StatsCounter counter, std::uint64_t amount = 1) {
+#if SVG_CONVERTER_STATS
+    detail::thread_stats().stats[counter] += amount;
+#else
+    (void)counter;
+    (void)amount;
+#endif
+}
+
+/**
+ * Attributes the time of its scope to a phase on the current thread, and
+ * records it as an event if tracing.
+ *
+ * Costs two clock readings, so it belongs around work measured in
+ * microseconds, not around every point.
+ */
+class ScopedPhase {
+#if SVG_CONVERTER_STATS
+ private:
+    StatsPhase outer_phase_;
+    bool traced_;
+
+ public:
+    explicit ScopedPhase(StatsPhase phase)
+        : outer_phase_{detail::thread_stats().phase}, traced_{tracing()} {
+        detail::thread_stats().switch_phase(phase);
+        if (traced_) {
+            trace_begin(stats_phase_name(phase));
+        }
+    }
+
+    ~ScopedPhase() {
+        if (traced_) {
+            trace_end();
+        }
+
+        detail::thread_stats().switch_phase(outer_phase_);
+    }
+#else
+ public:
+    explicit ScopedPhase(StatsPhase /*unused*/) {}
+#endif
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+};
+
+/**
+ * Statistics of the current thread so far.
+ *
+ * Statistics of a piece of work are the difference of the statistics after
+ * and before it, taken on the thread that did it. Work handed to other
+ * threads has to be counted on the thread that handed it out.
+ */
+Stats current_thread_stats();
+
+/**
+ * Writes statistics as a single JSON object, followed by a newline.
+ *
+ * @param wall_time Wall clock time of the whole run.
+ * @param files Number of converted files.
+ */
+void write_stats_json(std::ostream& out, const Stats& stats,
+                      std::chrono::steady_clock::duration wall_time,
+                      std::size_t files);
+
+#endif  // SVG_CONVERTER_STATS_H_
@@ -1,5 +1,29 @@
 #include "svg.h"
 
+#include <fcntl.h>
+#include <libxml/parserInternals.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "element_filter.h"
+#include "stats.h"
+#include "svg_input.h"
+
+/**
+ * Size of the chunks read from streams and passed to the push parser.
+ */
+constexpr std::size_t kStreamChunkSize = 64 * 1024;
+
 namespace detail {
 
 void Libxml2Deleter::operator()(xmlDocPtr doc) const { xmlFreeDoc(doc); }
@@ -8,8 +32,36 @@ void Libxml2Deleter::operator()(xmlErrorPtr error) const {
     xmlResetError(error);
 }
 
-void build_id_to_node_map(xmlNodePtr node,
-                          std::unordered_map<std::string, xmlNodePtr>& map) {
+void Libxml2Deleter::operator()(xmlParserCtxtPtr context) const {
+    xmlFreeParserCtxt(context);
+}
+
+/**
+ * Hashes a string with FNV-1a.
+ */
+std::size_t hash_id(boost::string_view id) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (char c : id) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+
+    return static_cast<std::size_t>(hash);
+}
+
+std::size_t IdIndex::slot_index(boost::string_view id,
+                                std::size_t hash) const {
+    std::size_t mask = slots_.size() - 1;
+    std::size_t index = hash & mask;
+    while (slots_[index].node != nullptr &&
+           (slots_[index].hash != hash || slots_[index].id != id)) {
+        index = (index + 1) & mask;
+    }
+
+    return index;
+}
+
+std::vector<IdIndex::Entry> IdIndex::collect_entries(xmlNodePtr root) {
     // A note on string handling:
     //
     // Libxml2 uses `xmlChar`s (which are an alias for `unsigned char`s)
@@ -19,33 +71,272 @@ void build_id_to_node_map(xmlNodePtr node,
     // export text that might contain unicode, we have to develop another
     // strategy.
 
-    constexpr xmlChar kIdAttribute[] = "id";
-    if (const xmlChar* id_attr =
-            xmlGetProp(node, static_cast<const xmlChar*>(kIdAttribute))) {
-        std::string id{reinterpret_cast<const char*>(id_attr)};  // NOLINT
-        map.insert({id, node});
+    // Collect ids in document order, only visiting elements. Iterative, so
+    // that deeply nested documents can't overflow the stack.
+    std::vector<Entry> entries;
+    xmlNodePtr node = root;
+    while (node != nullptr) {
+        for (xmlAttrPtr attr = node->properties; attr != nullptr;
+             attr = attr->next) {
+            if (!xmlStrEqual(attr->name, BAD_CAST "id") ||  // NOLINT
+                attr->children == nullptr) {
+                continue;
+            }
+
+            xmlNodePtr value = attr->children;
+            if (value->type == XML_TEXT_NODE && value->next == nullptr &&
+                value->content != nullptr) {
+                entries.push_back(
+                    {reinterpret_cast<const char*>(value->content),  // NOLINT
+                     node});
+                entries.back().hash = hash_id(entries.back().id);
+            } else if (xmlChar* text =
+                           xmlNodeListGetString(node->doc, value, 1)) {
+                owned_ids_.emplace_back(
+                    reinterpret_cast<const char*>(text));  // NOLINT
+                xmlFree(text);
+                entries.push_back({owned_ids_.back(), node});
+                entries.back().hash = hash_id(entries.back().id);
+            }
+        }
+
+        // Next element in document order
+        xmlNodePtr next = node->children;
+        while (next != nullptr && next->type != XML_ELEMENT_NODE) {
+            next = next->next;
+        }
+
+        while (next == nullptr && node != root) {
+            next = node->next;
+            while (next != nullptr && next->type != XML_ELEMENT_NODE) {
+                next = next->next;
+            }
+
+            node = node->parent;
+        }
+
+        node = next;
     }
 
-    for (xmlNodePtr child = node->children; child != nullptr;
-         child = child->next) {
-        build_id_to_node_map(child, map);
+    return entries;
+}
+
+IdIndex::IdIndex(xmlNodePtr root) { add(root); }
+
+void IdIndex::add(xmlNodePtr root) {
+    std::vector<Entry> entries = collect_entries(root);
+
+    // At most half full, so probe sequences stay short. Growing by doubling
+    // keeps adding many small subtrees linear overall.
+    std::size_t size = std::max<std::size_t>(slots_.size(), 16);
+    while (size < (entry_count_ + entries.size()) * 2) {
+        size *= 2;
+    }
+
+    if (size != slots_.size()) {
+        std::vector<Entry> old_slots(size);
+        old_slots.swap(slots_);
+        for (const Entry& entry : old_slots) {
+            if (entry.node != nullptr) {
+                slots_[slot_index(entry.id, entry.hash)] = entry;
+            }
+        }
+    }
+
+    for (const Entry& entry : entries) {
+        Entry& slot = slots_[slot_index(entry.id, entry.hash)];
+        if (slot.node == nullptr) {
+            slot = entry;
+            entry_count_++;
+        }
     }
 }
 
+xmlNodePtr IdIndex::find(boost::string_view id) const {
+    return slots_[slot_index(id, hash_id(id))].node;
+}
+
 }  // namespace detail
 
-SvgLoadError::SvgLoadError(xmlErrorPtr errorPtr)
-    : error_{std::make_unique<xmlError>()} {
-    xmlCopyError(errorPtr, error_.get());
+/**
+ * Takes the document out of a context that has finished parsing.
+ *
+ * @return The document, null if it is malformed.
+ */
+xmlDocPtr take_document(xmlParserCtxtPtr context) {
+    // Malformed documents may still have produced a partial tree
+    std::unique_ptr<xmlDoc, detail::Libxml2Deleter> doc{context->myDoc};
+    context->myDoc = nullptr;
+    if (context->wellFormed == 0) {
+        return nullptr;
+    }
+
+    return doc.release();
 }
 
-SvgDocument::SvgDocument(const std::string& filename)
-    : doc_{xmlParseFile(filename.c_str())} {
+/**
+ * Parses a document with a parser context that has not parsed anything yet.
+ *
+ * Unused elements are dropped while parsing, see `SaxElementFilter`.
+ *
+ * @param name Name of the input used in error messages, may be null.
+ * @return The document, null if it is malformed.
+ */
+xmlDocPtr parse_filtered(xmlParserCtxtPtr raw_context, const char* name) {
+    std::unique_ptr<xmlParserCtxt, detail::Libxml2Deleter> context{
+        raw_context};
+    if (!context) {
+        return nullptr;
+    }
+
+    if (name != nullptr && context->input != nullptr &&
+        context->input->filename == nullptr) {
+        context->input->filename =
+            reinterpret_cast<char*>(xmlStrdup(BAD_CAST name));  // NOLINT
+    }
+
+    xmlCtxtUseOptions(context.get(), detail::kParseOptions);
+    SaxElementFilter filter;
+    filter.install(context.get());
+    xmlParseDocument(context.get());
+    return take_document(context.get());
+}
+
+/**
+ * Parses a document with the push parser, feeding it chunk by chunk.
+ *
+ * Used for compressed data and for inputs that can't be mapped into memory.
+ */
+xmlDocPtr parse_input(SvgInput& input) {
+    ScopedPhase phase{StatsPhase::kParse};
+    std::vector<char> buffer(kStreamChunkSize);
+    std::size_t size = input.read(buffer.data(), buffer.size());
+
+    // The first chunk is used to detect the encoding
+    std::unique_ptr<xmlParserCtxt, detail::Libxml2Deleter> context{
+        xmlCreatePushParserCtxt(nullptr, nullptr, buffer.data(),
+                                static_cast<int>(size), input.name().c_str())};
+    if (!context) {
+        throw SvgLoadError{"Failed to create parser for " + input.name()};
+    }
+
+    xmlCtxtUseOptions(context.get(), detail::kParseOptions);
+    SaxElementFilter filter;
+    filter.install(context.get());
+    try {
+        do {
+            size = input.read(buffer.data(), buffer.size());
+            if (xmlParseChunk(context.get(), buffer.data(),
+                              static_cast<int>(size), size == 0 ? 1 : 0) != 0) {
+                break;
+            }
+        } while (size > 0);
+    } catch (...) {
+        // Freeing the context doesn't free the partial tree built so far
+        xmlFreeDoc(context->myDoc);
+        context->myDoc = nullptr;
+        throw;
+    }
+
+    return take_document(context.get());
+}
+
+/**
+ * Parses a file by mapping it into memory.
+ *
+ * Falls back to reading the file as a stream for anything that can't be
+ * mapped, like pipes, empty files, or files too large for libxml2's memory
+ * parser. Compressed files are decompressed from the mapping.
+ */
+xmlDocPtr parse_mapped_file(const std::string& filename) {
+    ScopedPhase phase{StatsPhase::kParse};
+    xmlResetLastError();
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);  // NOLINT
+    if (fd < 0) {
+        throw SvgLoadError{"Failed to open " + filename + ": " +
+                           std::strerror(errno)};
+    }
+
+    struct stat file_info {};
+    if (fstat(fd, &file_info) != 0 || !S_ISREG(file_info.st_mode) ||
+        file_info.st_size == 0 ||
+        file_info.st_size > std::numeric_limits<int>::max()) {
+        SvgInput input{fd, filename, true};
+        return parse_input(input);
+    }
+
+    auto size = static_cast<std::size_t>(file_info.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {  // NOLINT
+        SvgInput input{fd, filename, true};
+        return parse_input(input);
+    }
+
+    ::close(fd);
+    madvise(data, size, MADV_SEQUENTIAL);
+    const char* bytes = static_cast<const char*>(data);
+    xmlDocPtr doc = nullptr;
+    try {
+        if (has_gzip_magic(bytes, size)) {
+            SvgInput input{bytes, size, filename};
+            doc = parse_input(input);
+        } else {
+            doc = parse_filtered(
+                xmlCreateMemoryParserCtxt(bytes, static_cast<int>(size)),
+                filename.c_str());
+        }
+    } catch (...) {
+        munmap(data, size);
+        throw;
+    }
+
+    munmap(data, size);
+    return doc;
+}
+
+/**
+ * Parses a document from memory.
+ *
+ * Compressed data and data too large for libxml2's memory parser is passed
+ * to the push parser instead.
+ */
+xmlDocPtr parse_memory(const char* data, std::size_t size) {
+    ScopedPhase phase{StatsPhase::kParse};
+    xmlResetLastError();
+    if (has_gzip_magic(data, size) ||
+        size > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+        SvgInput input{data, size, "memory"};
+        return parse_input(input);
+    }
+
+    return parse_filtered(
+        xmlCreateMemoryParserCtxt(data, static_cast<int>(size)), nullptr);
+}
+
+SvgLoadError::SvgLoadError(xmlErrorPtr errorPtr)
+    : message_{errorPtr != nullptr && errorPtr->message != nullptr
+                   ? errorPtr->message
+                   : "Unknown error"} {}
+
+SvgLoadError::SvgLoadError(std::string message)
+    : message_{std::move(message)} {}
+
+SvgDocument::SvgDocument(xmlDocPtr doc) : doc_{doc} {
     if (!doc_) {
         throw SvgLoadError{xmlGetLastError()};
     }
+}
+
+SvgDocument::SvgDocument(const std::string& filename)
+    : SvgDocument{parse_mapped_file(filename)} {}
 
-    detail::build_id_to_node_map(root(), nodes_by_id_);
+SvgDocument::SvgDocument(const char* data, std::size_t size)
+    : SvgDocument{parse_memory(data, size)} {}
+
+SvgDocument SvgDocument::read_stream(int fd, const std::string& name) {
+    xmlResetLastError();
+    SvgInput input{fd, name};
+    return SvgDocument{parse_input(input)};
 }
 
 xmlNodePtr SvgDocument::root() const {
@@ -53,8 +344,28 @@ xmlNodePtr SvgDocument::root() const {
 }
 
 xmlNodePtr SvgDocument::find_by_id(const std::string& id) const {
-    auto iter = nodes_by_id_.find(id);
-    return iter == nodes_by_id_.end() ? nullptr : iter->second;
+    if (!id_index_) {
+        ScopedPhase phase{StatsPhase::kIdIndex};
+        id_index_ = std::make_unique<detail::IdIndex>(root());
+    }
+
+    return id_index_->find(id);
+}
+
+xmlNodePtr SvgDocument::append_copy(xmlNodePtr element) {
+    xmlNodePtr copy = xmlDocCopyNode(element, doc_.get(), 1);
+    if (copy == nullptr) {
+        throw std::bad_alloc{};
+    }
+
+    xmlAddChild(root(), copy);
+    // The copy comes last in document order, so its ids can simply be added
+    // without rebuilding the index
+    if (id_index_) {
+        id_index_->add(copy);
+    }
+
+    return copy;
 }
 
-const char* SvgLoadError::what() const noexcept { return error_->message; }
+const char* SvgLoadError::what() const noexcept { return message_.c_str(); }
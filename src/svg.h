@@ -4,14 +4,28 @@
 #include <libxml/parser.h>
 #include <libxml/xmlerror.h>
 
+#include <cstddef>
+#include <deque>
 #include <memory>
 #include <stdexcept>
 #include <string>
 #include <type_traits>
-#include <unordered_map>
+#include <vector>
+
+#include <boost/utility/string_view.hpp>
 
 namespace detail {
 
+/**
+ * Options for all documents parsed by libxml2.
+ *
+ * Tuned for throughput: Text nodes are stored inline, no network access, no
+ * arbitrary limits on node sizes (base64 encoded images can be huge), and
+ * whitespace only text nodes are dropped, because nothing uses them.
+ */
+constexpr int kParseOptions =
+    XML_PARSE_COMPACT | XML_PARSE_NONET | XML_PARSE_HUGE | XML_PARSE_NOBLANKS;
+
 /**
  * `std::unique_ptr` deleter for libxml2 elements.
  */
@@ -19,21 +33,129 @@ struct Libxml2Deleter {
     void operator()(xmlDocPtr doc) const;
 
     void operator()(xmlErrorPtr error) const;
+
+    void operator()(xmlParserCtxtPtr context) const;
+};
+
+/**
+ * Maps the `id` attributes of all elements of a document to their elements.
+ *
+ * A flat hash table with open addressing (linear probing). Keys are views
+ * into the attribute text owned by libxml2 (short values are interned in the
+ * document's dictionary), so they are valid for the lifetime of the document
+ * and building the index doesn't copy any strings. If an id is used more
+ * than once, the first element in document order wins.
+ */
+class IdIndex {
+ private:
+    struct Entry {
+        boost::string_view id;
+        xmlNodePtr node = nullptr;
+
+        /**
+         * Hash of the id, compared first to avoid touching the id text.
+         */
+        std::size_t hash = 0;
+    };
+
+    /**
+     * Table with a power of two size, empty slots have a null node.
+     */
+    std::vector<Entry> slots_;
+
+    /**
+     * Ids that consist of several text nodes (due to entity references) and
+     * had to be concatenated.
+     */
+    std::deque<std::string> owned_ids_;
+
+    /**
+     * Number of occupied slots.
+     */
+    std::size_t entry_count_ = 0;
+
+    std::size_t slot_index(boost::string_view id, std::size_t hash) const;
+
+    /**
+     * Ids of all elements below and including the given one, in document
+     * order.
+     */
+    std::vector<Entry> collect_entries(xmlNodePtr root);
+
+ public:
+    /**
+     * Indexes all elements below and including the given one.
+     */
+    explicit IdIndex(xmlNodePtr root);
+
+    /**
+     * Indexes all elements below and including the given one, which must
+     * come after all indexed elements in document order. Ids that are
+     * already indexed keep their element.
+     */
+    void add(xmlNodePtr root);
+
+    /**
+     * Finds an element by its id, null if there is none.
+     */
+    xmlNodePtr find(boost::string_view id) const;
 };
 
 }  // namespace detail
 
+/**
+ * A parsed SVG document.
+ *
+ * Documents loaded from files, buffers and streams may be gzip compressed
+ * (`.svgz`). Compression is detected by the magic bytes, and the data is
+ * decompressed while parsing.
+ */
 class SvgDocument {
  private:
     std::unique_ptr<xmlDoc, detail::Libxml2Deleter> doc_;
-    std::unordered_map<std::string, xmlNodePtr> nodes_by_id_;
+
+    /**
+     * Index of all ids, built on the first lookup.
+     *
+     * Most documents never reference anything, so building it up front would
+     * be wasted work. Lookups are not thread safe because of this.
+     */
+    mutable std::unique_ptr<detail::IdIndex> id_index_;
 
  public:
+    /**
+     * Takes ownership of a parsed document.
+     *
+     * @throws SvgLoadError If the document is null.
+     */
+    explicit SvgDocument(xmlDocPtr doc);
+
     /**
      * Loads an XML document from the given file.
+     *
+     * Regular files are mapped into memory read-only instead of being read
+     * through a stream.
      */
     explicit SvgDocument(const std::string& filename);
 
+    /**
+     * Loads an XML document from a buffer.
+     *
+     * The buffer is only accessed during construction.
+     */
+    SvgDocument(const char* data, std::size_t size);
+
+    /**
+     * Loads an XML document from a file descriptor, like stdin.
+     *
+     * Data is fed to libxml2's push parser chunk by chunk as it arrives, so
+     * parsing overlaps with reading and the raw input is never held in
+     * memory completely.
+     *
+     * @param name Name of the input used in error messages.
+     */
+    static SvgDocument read_stream(int fd, const std::string& name);
+
     /**
      * Pointer to the root node of the document.
      *
@@ -43,17 +165,36 @@ class SvgDocument {
 
     /**
      * Finds a node by its `id` attribute.
+     *
+     * Indexes the document on the first call.
      */
     xmlNodePtr find_by_id(const std::string& id) const;
+
+    /**
+     * Copies an element and its subtree from another document to the end of
+     * the root element.
+     *
+     * Used to collect the elements of a streamed document that may be
+     * referenced later on. Extends an existing id index with the ids of the
+     * copy, so collecting many elements stays linear.
+     *
+     * @return The copy.
+     */
+    xmlNodePtr append_copy(xmlNodePtr element);
 };
 
 class SvgLoadError : public std::exception {
  private:
-    std::unique_ptr<xmlError> error_;
+    std::string message_;
 
  public:
+    /**
+     * Creates an error from a libxml2 error, which may be null.
+     */
     explicit SvgLoadError(xmlErrorPtr errorPtr);
 
+    explicit SvgLoadError(std::string message);
+
     const char* what() const noexcept override;
 };
 
@@ -0,0 +1,189 @@
+#include "svg_input.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include "svg.h"
+
+/**
+ * Size of the buffer for reading compressed data.
+ */
+constexpr std::size_t kInputBufferSize = 64 * 1024;
+
+/**
+ * Tells zlib to expect gzip data with the maximum window size.
+ */
+constexpr int kGzipWindowBits = 16 + MAX_WBITS;
+
+/**
+ * Reads from a file descriptor, retrying on interrupts.
+ *
+ * @return Number of bytes read, 0 at the end of the stream.
+ */
+std::size_t read_chunk(int fd, char* buffer, std::size_t size,
+                       const std::string& name) {
+    while (true) {
+        ssize_t result = ::read(fd, buffer, size);
+        if (result >= 0) {
+            return static_cast<std::size_t>(result);
+        }
+
+        if (errno != EINTR) {
+            throw SvgLoadError{"Failed to read " + name + ": " +
+                               std::strerror(errno)};
+        }
+    }
+}
+
+/**
+ * Clamps a size to the range of zlib's sizes.
+ */
+uInt to_zlib_size(std::size_t size) {
+    return static_cast<uInt>(
+        std::min<std::size_t>(size, std::numeric_limits<uInt>::max()));
+}
+
+bool has_gzip_magic(const char* data, std::size_t size) {
+    return size >= 2 && static_cast<unsigned char>(data[0]) == 0x1f &&
+           static_cast<unsigned char>(data[1]) == 0x8b;
+}
+
+void SvgInput::InflaterDeleter::operator()(z_stream* stream) const {
+    inflateEnd(stream);
+    delete stream;  // NOLINT
+}
+
+SvgInput::SvgInput(int fd, std::string name, bool owns_fd)
+    : fd_{fd},
+      owns_fd_{owns_fd},
+      name_{std::move(name)},
+      buffer_(kInputBufferSize) {
+    pending_ = buffer_.data();
+    try {
+        while (pending_size_ < 2 && fill()) {
+        }
+
+        if (has_gzip_magic(pending_, pending_size_)) {
+            start_inflating();
+        }
+    } catch (...) {
+        // The destructor doesn't run for a failed constructor
+        if (owns_fd_) {
+            ::close(fd_);
+        }
+
+        throw;
+    }
+}
+
+SvgInput::SvgInput(const char* data, std::size_t size, std::string name)
+    : name_{std::move(name)},
+      pending_{data},
+      pending_size_{size},
+      end_of_input_{true} {
+    if (has_gzip_magic(pending_, pending_size_)) {
+        start_inflating();
+    }
+}
+
+SvgInput::~SvgInput() {
+    if (owns_fd_) {
+        ::close(fd_);
+    }
+}
+
+bool SvgInput::fill() {
+    if (end_of_input_) {
+        return false;
+    }
+
+    // Only called with less than a buffer of pending input
+    std::memmove(buffer_.data(), pending_, pending_size_);
+    pending_ = buffer_.data();
+    std::size_t size = read_chunk(fd_, buffer_.data() + pending_size_,
+                                  buffer_.size() - pending_size_, name_);
+    if (size == 0) {
+        end_of_input_ = true;
+        return false;
+    }
+
+    pending_size_ += size;
+    return true;
+}
+
+void SvgInput::start_inflating() {
+    auto stream = std::make_unique<z_stream>();
+    if (inflateInit2(stream.get(), kGzipWindowBits) != Z_OK) {
+        throw SvgLoadError{"Failed to initialize decompression of " + name_};
+    }
+
+    inflater_.reset(stream.release());
+}
+
+std::size_t SvgInput::read_compressed(char* buffer, std::size_t size) {
+    z_stream* stream = inflater_.get();
+    stream->next_out = reinterpret_cast<Bytef*>(buffer);  // NOLINT
+    stream->avail_out = to_zlib_size(size);
+    const uInt available_out = stream->avail_out;
+
+    // Compressed input may not produce any output for a while
+    while (!end_of_data_ && stream->avail_out == available_out) {
+        if (pending_size_ == 0 && !fill()) {
+            throw SvgLoadError{"Unexpected end of compressed data in " +
+                               name_};
+        }
+
+        // zlib only declares the input as const with ZLIB_CONST
+        stream->next_in = const_cast<Bytef*>(           // NOLINT
+            reinterpret_cast<const Bytef*>(pending_));  // NOLINT
+        stream->avail_in = to_zlib_size(pending_size_);
+        const uInt available_in = stream->avail_in;
+        int result = inflate(stream, Z_NO_FLUSH);
+        std::size_t consumed = available_in - stream->avail_in;
+        pending_ += consumed;
+        pending_size_ -= consumed;
+
+        if (result == Z_STREAM_END) {
+            // Another gzip member may follow, anything else is ignored
+            while (pending_size_ < 2 && fill()) {
+            }
+
+            if (has_gzip_magic(pending_, pending_size_)) {
+                inflateReset(stream);
+            } else {
+                end_of_data_ = true;
+            }
+        } else if (result != Z_OK && result != Z_BUF_ERROR) {
+            throw SvgLoadError{
+                "Failed to decompress " + name_ + ": " +
+                (stream->msg != nullptr ? stream->msg : "Invalid data")};
+        }
+    }
+
+    return available_out - stream->avail_out;
+}
+
+std::size_t SvgInput::read(char* buffer, std::size_t size) {
+    if (inflater_) {
+        return read_compressed(buffer, size);
+    }
+
+    if (pending_size_ > 0) {
+        std::size_t count = std::min(size, pending_size_);
+        std::memcpy(buffer, pending_, count);
+        pending_ += count;
+        pending_size_ -= count;
+        return count;
+    }
+
+    if (end_of_input_) {
+        return 0;
+    }
+
+    return read_chunk(fd_, buffer, size, name_);
+}
@@ -0,0 +1,111 @@
+#ifndef SVG_CONVERTER_SVG_INPUT_H_
+#define SVG_CONVERTER_SVG_INPUT_H_
+
+#include <zlib.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Whether data starts with the magic bytes of gzip (used by `.svgz` files).
+ */
+bool has_gzip_magic(const char* data, std::size_t size);
+
+/**
+ * Sequential reader for SVG data that transparently decompresses gzip.
+ *
+ * Reads from a file descriptor or from memory. Compressed input is detected
+ * by its magic bytes and inflated chunk by chunk as it is read, so the
+ * decompressed document never needs to be held in memory at once.
+ * Concatenated gzip members are decompressed one after another, like
+ * `gunzip` does.
+ */
+class SvgInput {
+ private:
+    struct InflaterDeleter {
+        void operator()(z_stream* stream) const;
+    };
+
+    int fd_ = -1;
+    bool owns_fd_ = false;
+    std::string name_;
+
+    /**
+     * Buffer for reading compressed data from the file descriptor.
+     */
+    std::vector<char> buffer_;
+
+    /**
+     * Input that has been read (or is in memory) but not consumed yet.
+     */
+    const char* pending_ = nullptr;
+    std::size_t pending_size_ = 0;
+
+    /**
+     * Whether all input has been read into `pending_`.
+     */
+    bool end_of_input_ = false;
+
+    /**
+     * Inflater for compressed input, null for plain input.
+     */
+    std::unique_ptr<z_stream, InflaterDeleter> inflater_;
+
+    bool end_of_data_ = false;
+
+    /**
+     * Reads more input from the file descriptor, appending it to the pending
+     * input.
+     *
+     * @return False at the end of the input.
+     */
+    bool fill();
+
+    void start_inflating();
+
+    std::size_t read_compressed(char* buffer, std::size_t size);
+
+ public:
+    /**
+     * Reads from a file descriptor.
+     *
+     * Reads the first bytes to detect compression.
+     *
+     * @param name Name of the input used in error messages.
+     * @param owns_fd Whether to close the file descriptor on destruction.
+     * @throws SvgLoadError If reading fails.
+     */
+    SvgInput(int fd, std::string name, bool owns_fd = false);
+
+    /**
+     * Reads from memory, which must stay valid for the lifetime of the input.
+     */
+    SvgInput(const char* data, std::size_t size, std::string name);
+
+    ~SvgInput();
+
+    SvgInput(const SvgInput&) = delete;
+    SvgInput& operator=(const SvgInput&) = delete;
+
+    /**
+     * Whether the input is gzip compressed.
+     */
+    bool compressed() const { return inflater_ != nullptr; }
+
+    /**
+     * Name of the input used in error messages.
+     */
+    const std::string& name() const { return name_; }
+
+    /**
+     * Reads the next (decompressed) bytes.
+     *
+     * @return Number of bytes read, 0 at the end of the data.
+     * @throws SvgLoadError If reading or decompressing fails.
+     */
+    std::size_t read(char* buffer, std::size_t size);
+};
+
+#endif  // SVG_CONVERTER_SVG_INPUT_H_
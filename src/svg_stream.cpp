@@ -0,0 +1,440 @@
+#include "svg_stream.h"
+
+#include <fcntl.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <boost/optional.hpp>
+#include <boost/utility/string_view.hpp>
+
+#include "element_filter.h"
+#include "stats.h"
+
+/**
+ * Namespace of SVG elements.
+ */
+constexpr const char* kSvgNamespace = "http://www.w3.org/2000/svg";
+
+/**
+ * Elements that are traversed including their children.
+ *
+ * Must match the structural elements in `ProcessedElements` (traversal.h).
+ */
+constexpr std::array<const char*, 2> kContainerElements{{"g", "svg"}};
+
+/**
+ * Shape elements, see `svgpp::traits::shape_elements`.
+ */
+constexpr std::array<const char*, 7> kShapeElements{
+    {"circle", "ellipse", "line", "path", "polygon", "polyline", "rect"}};
+
+/**
+ * Elements that can be referenced by the `fill` of a shape.
+ */
+constexpr std::array<const char*, 3> kPaintServerElements{
+    {"linearGradient", "pattern", "radialGradient"}};
+
+template <std::size_t N>
+bool is_svg_element(xmlNodePtr node, const std::array<const char*, N>& names) {
+    if (node->type != XML_ELEMENT_NODE ||
+        (node->ns != nullptr &&
+         !xmlStrEqual(node->ns->href, BAD_CAST kSvgNamespace))) {  // NOLINT
+        return false;
+    }
+
+    for (const char* name : names) {
+        if (xmlStrEqual(node->name, BAD_CAST name)) {  // NOLINT
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Removes leading and trailing whitespace.
+ */
+boost::string_view trim(boost::string_view value) {
+    const char* whitespace = " \t\n\r\f";
+    std::size_t begin = value.find_first_not_of(whitespace);
+    if (begin == boost::string_view::npos) {
+        return {};
+    }
+
+    std::size_t end = value.find_last_not_of(whitespace);
+    return value.substr(begin, end - begin + 1);
+}
+
+/**
+ * Extracts the id from a `url(#id)` paint value, none for other values.
+ */
+boost::optional<std::string> paint_fragment_id(boost::string_view value) {
+    value = trim(value);
+    if (!value.starts_with("url(")) {
+        return boost::none;
+    }
+
+    value.remove_prefix(4);
+    std::size_t end = value.find(')');
+    if (end == boost::string_view::npos) {
+        return boost::none;
+    }
+
+    value = trim(value.substr(0, end));
+    if (value.size() >= 2 && (value.front() == '"' || value.front() == '\'') &&
+        value.back() == value.front()) {
+        value = value.substr(1, value.size() - 2);
+    }
+
+    if (!value.starts_with("#")) {
+        return boost::none;
+    }
+
+    return value.substr(1).to_string();
+}
+
+/**
+ * Id of the paint server referenced by the `fill` of a shape, if any.
+ *
+ * Looks at the `fill` property in the `style` attribute, which takes
+ * precedence, and at the `fill` attribute.
+ */
+boost::optional<std::string> fill_reference(xmlNodePtr shape) {
+    boost::optional<std::string> id;
+    if (xmlChar* fill = xmlGetNoNsProp(shape, BAD_CAST "fill")) {  // NOLINT
+        id = paint_fragment_id(reinterpret_cast<char*>(fill));  // NOLINT
+        xmlFree(fill);
+    }
+
+    if (xmlChar* style = xmlGetNoNsProp(shape, BAD_CAST "style")) {  // NOLINT
+        boost::string_view declarations{
+            reinterpret_cast<char*>(style)};  // NOLINT
+        while (!declarations.empty()) {
+            std::size_t end = declarations.find(';');
+            boost::string_view declaration = declarations.substr(0, end);
+            declarations.remove_prefix(end == boost::string_view::npos
+                                           ? declarations.size()
+                                           : end + 1);
+
+            std::size_t colon = declaration.find(':');
+            if (colon != boost::string_view::npos &&
+                trim(declaration.substr(0, colon)) == "fill") {
+                id = paint_fragment_id(declaration.substr(colon + 1));
+            }
+        }
+
+        xmlFree(style);
+    }
+
+    return id;
+}
+
+/**
+ * Copy of a part of a streamed document.
+ *
+ * Consists of a chain of open elements, copied without their children, with
+ * complete elements appended below them.
+ */
+class PartialDocument {
+ private:
+    struct OpenElement {
+        /**
+         * Identifies the element in the streamed document, copies of the
+         * same element in different partial documents share it.
+         */
+        std::size_t serial;
+
+        xmlNodePtr copy;
+    };
+
+    std::unique_ptr<xmlDoc, detail::Libxml2Deleter> doc_;
+
+    /**
+     * Open elements, starting with the root element.
+     */
+    std::vector<OpenElement> open_;
+
+    std::size_t element_count_ = 0;
+
+    xmlNodePtr add_copy(xmlNodePtr element, int extended) {
+        xmlNodePtr copy = xmlDocCopyNode(element, doc_.get(), extended);
+        if (copy == nullptr) {
+            throw std::bad_alloc{};
+        }
+
+        if (open_.empty()) {
+            // Replaces the root of the previous pass, if any
+            xmlFreeNode(xmlDocSetRootElement(doc_.get(), copy));
+        } else {
+            xmlAddChild(open_.back().copy, copy);
+        }
+
+        return copy;
+    }
+
+ public:
+    PartialDocument() : doc_{xmlNewDoc(BAD_CAST "1.0")} {  // NOLINT
+        if (!doc_) {
+            throw std::bad_alloc{};
+        }
+    }
+
+    /**
+     * Root element of the copy, null if nothing has been copied yet.
+     */
+    xmlNodePtr root() const { return xmlDocGetRootElement(doc_.get()); }
+
+    /**
+     * Number of complete elements appended since the last clear.
+     */
+    std::size_t element_count() const { return element_count_; }
+
+    /**
+     * Copies an element without its children and opens it.
+     */
+    void open(xmlNodePtr element, std::size_t serial) {
+        open_.push_back({serial, add_copy(element, 2)});
+    }
+
+    void close() { open_.pop_back(); }
+
+    /**
+     * Copies a complete element, including its children, below the innermost
+     * open element.
+     */
+    void append(xmlNodePtr element) {
+        add_copy(element, 1);
+        element_count_++;
+    }
+
+    /**
+     * Copies a complete element below the same open elements as in another
+     * partial document, opening (copies of) them as necessary.
+     */
+    void append_mirrored(xmlNodePtr element, const PartialDocument& other) {
+        std::size_t common = 0;
+        while (common < open_.size() && common < other.open_.size() &&
+               open_[common].serial == other.open_[common].serial) {
+            common++;
+        }
+
+        open_.resize(common);
+        for (std::size_t i = common; i < other.open_.size(); i++) {
+            open(other.open_[i].copy, other.open_[i].serial);
+        }
+
+        append(element);
+    }
+
+    /**
+     * Removes all complete elements, so that only the open ones are left.
+     */
+    void clear_complete() {
+        xmlNodePtr parent = root();
+        for (std::size_t i = 1; parent != nullptr; i++) {
+            // An open element is always the last child of its parent
+            xmlNodePtr keep = i < open_.size() ? open_[i].copy : nullptr;
+            xmlNodePtr child = parent->children;
+            while (child != nullptr && child != keep) {
+                xmlNodePtr next = child->next;
+                xmlUnlinkNode(child);
+                xmlFreeNode(child);
+                child = next;
+            }
+
+            parent = keep;
+        }
+
+        element_count_ = 0;
+    }
+};
+
+/**
+ * Creates an empty document to collect referenced elements in.
+ */
+SvgDocument create_resources_document() {
+    xmlDocPtr doc = xmlNewDoc(BAD_CAST "1.0");  // NOLINT
+    SvgDocument resources{doc};
+    xmlNodePtr root = xmlNewDocNode(doc, nullptr, BAD_CAST "svg",  // NOLINT
+                                    nullptr);
+    if (root == nullptr) {
+        throw std::bad_alloc{};
+    }
+
+    xmlDocSetRootElement(doc, root);
+    return resources;
+}
+
+void SvgStream::ReaderDeleter::operator()(xmlTextReaderPtr reader) const {
+    xmlFreeTextReader(reader);
+}
+
+int SvgStream::read_input(void* context, char* buffer, int size) {
+    auto* input = static_cast<Input*>(context);
+    try {
+        return static_cast<int>(
+            input->source.read(buffer, static_cast<std::size_t>(size)));
+    } catch (...) {
+        input->error = std::current_exception();
+        return -1;
+    }
+}
+
+SvgStream::SvgStream(std::unique_ptr<Input> input, std::size_t window_size)
+    : input_{std::move(input)},
+      reader_{xmlReaderForIO(&SvgStream::read_input, nullptr, input_.get(),
+                             input_->source.name().c_str(), nullptr,
+                             detail::kParseOptions)},
+      window_size_{window_size} {
+    if (!reader_) {
+        throw SvgLoadError{xmlGetLastError()};
+    }
+}
+
+std::unique_ptr<SvgStream::Input> SvgStream::open_file(
+    const std::string& filename) {
+    xmlResetLastError();
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);  // NOLINT
+    if (fd < 0) {
+        throw SvgLoadError{"Failed to open " + filename + ": " +
+                           std::strerror(errno)};
+    }
+
+    return std::make_unique<Input>(fd, filename, true);
+}
+
+SvgStream::SvgStream(const std::string& filename, std::size_t window_size)
+    : SvgStream{open_file(filename), window_size} {}
+
+SvgStream SvgStream::from_fd(int fd, const std::string& name,
+                             std::size_t window_size) {
+    xmlResetLastError();
+    return SvgStream{std::make_unique<Input>(fd, name), window_size};
+}
+
+SvgStreamStats SvgStream::read(const TraverseFunction& traverse) {
+    // Traversal of the partial documents is nested inside
+    ScopedPhase phase{StatsPhase::kParse};
+    xmlTextReaderPtr reader = reader_.get();
+    SvgDocument resources = create_resources_document();
+    PartialDocument window;
+    PartialDocument deferred;
+    SvgStreamStats stats;
+    std::size_t next_serial = 0;
+
+    auto pass_on_window = [&]() {
+        traverse(resources, window.root());
+        window.clear_complete();
+        stats.passes++;
+    };
+
+    // Number of open elements that aren't traversed, like `<defs>`. Only
+    // paint servers are collected inside of them, which doesn't require
+    // expanding them as a whole.
+    std::size_t untraversed_depth = 0;
+
+    int result = xmlTextReaderRead(reader);
+    while (result == 1) {
+        int type = xmlTextReaderNodeType(reader);
+        if (type == XML_READER_TYPE_END_ELEMENT) {
+            if (untraversed_depth > 0) {
+                untraversed_depth--;
+            } else {
+                window.close();
+            }
+
+            result = xmlTextReaderRead(reader);
+            continue;
+        }
+
+        xmlNodePtr node = xmlTextReaderCurrentNode(reader);
+        if (type != XML_READER_TYPE_ELEMENT) {
+            result = xmlTextReaderRead(reader);
+            continue;
+        }
+
+        // The root element is always traversed, like in a complete document
+        bool is_root = window.root() == nullptr;
+        const xmlChar* namespace_uri =
+            node->ns != nullptr ? node->ns->href : nullptr;
+        if (!is_root && is_unused_element(node->name, namespace_uri)) {
+            result = xmlTextReaderNext(reader);
+            continue;
+        }
+
+        bool is_paint_server = is_svg_element(node, kPaintServerElements);
+        if (untraversed_depth == 0 &&
+            (is_root || is_svg_element(node, kContainerElements))) {
+            window.open(node, next_serial++);
+            if (xmlTextReaderIsEmptyElement(reader) == 1) {
+                window.close();
+            }
+
+            result = xmlTextReaderRead(reader);
+            continue;
+        }
+
+        if (!is_paint_server && (untraversed_depth > 0 ||
+                                 !is_svg_element(node, kShapeElements))) {
+            // Wrappers like `<defs>`, `<a>` or `<switch>` can span the whole
+            // drawing, so they are read element by element as well
+            if (xmlTextReaderIsEmptyElement(reader) != 1) {
+                untraversed_depth++;
+            }
+
+            result = xmlTextReaderRead(reader);
+            continue;
+        }
+
+        xmlNodePtr subtree = xmlTextReaderExpand(reader);
+        if (subtree == nullptr) {
+            result = -1;
+            break;
+        }
+
+        if (is_paint_server) {
+            resources.append_copy(subtree);
+        } else {
+            boost::optional<std::string> reference = fill_reference(subtree);
+            if (reference && resources.find_by_id(*reference) == nullptr) {
+                deferred.append_mirrored(subtree, window);
+                stats.deferred_shapes++;
+            } else {
+                window.append(subtree);
+                if (window.element_count() >= window_size_) {
+                    pass_on_window();
+                }
+            }
+        }
+
+        result = xmlTextReaderNext(reader);
+    }
+
+    if (input_->error) {
+        std::rethrow_exception(input_->error);
+    }
+
+    if (result < 0) {
+        throw SvgLoadError{xmlGetLastError()};
+    }
+
+    if (window.root() == nullptr) {
+        throw SvgLoadError{"Document has no root element"};
+    }
+
+    if (window.element_count() > 0 || stats.passes == 0) {
+        pass_on_window();
+    }
+
+    if (deferred.root() != nullptr) {
+        traverse(resources, deferred.root());
+        stats.passes++;
+    }
+
+    return stats;
+}
@@ -0,0 +1,136 @@
+#ifndef SVG_CONVERTER_SVG_STREAM_H_
+#define SVG_CONVERTER_SVG_STREAM_H_
+
+#include <libxml/xmlreader.h>
+
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "svg.h"
+#include "svg_input.h"
+
+/**
+ * Statistics about a streamed document.
+ */
+struct SvgStreamStats {
+    /**
+     * Number of partial documents passed on.
+     */
+    std::size_t passes = 0;
+
+    /**
+     * Number of shapes held back until the end of the document, because they
+     * referenced a pattern that had not been read yet.
+     */
+    std::size_t deferred_shapes = 0;
+};
+
+/**
+ * Reads an SVG document piece by piece with libxml2's `xmlTextReader`.
+ *
+ * Instead of a DOM of the complete document, only a partial copy is kept:
+ * The `<svg>` and `<g>` elements enclosing the current position (without
+ * their children), and the shapes that have been read since the copy was
+ * last passed on. It's passed on whenever enough shapes have been read, and
+ * at the end of the document, so memory is bounded by the nesting depth
+ * and the window size instead of the size of the document. Elements that
+ * aren't traversed, like `<defs>`, `<a>` or `<switch>`, are read element by
+ * element as well, only paint servers inside of them are expanded.
+ *
+ * Paint servers (`<pattern>`s and gradients) are the only elements that can
+ * be referenced by shapes. They are collected into a separate resources
+ * document for the whole duration of reading. Shapes referencing a paint
+ * server that has not been read yet are held back in another partial copy,
+ * which is passed on at the end of the document.
+ *
+ * Elements that `is_unused_element` reports are skipped without copying.
+ * Gzip compressed input is decompressed on the fly, see `SvgInput`.
+ */
+class SvgStream {
+ public:
+    /**
+     * Function converting a partial copy of the document.
+     *
+     * @param resources Document to look up referenced elements in.
+     * @param root Root element of the partial copy, only valid during the
+     *             call.
+     */
+    using TraverseFunction =
+        std::function<void(const SvgDocument& resources, xmlNodePtr root)>;
+
+    /**
+     * Default number of shapes after which the partial copy is passed on.
+     *
+     * Every pass processes the enclosing elements again, so passing on every
+     * shape on its own would be wasteful.
+     */
+    static constexpr std::size_t kDefaultWindowSize = 1024;
+
+ private:
+    struct ReaderDeleter {
+        void operator()(xmlTextReaderPtr reader) const;
+    };
+
+    /**
+     * Input of the reader, together with the error that made the last read
+     * fail. Errors can't be thrown through libxml2.
+     */
+    struct Input {
+        SvgInput source;
+        std::exception_ptr error;
+
+        template <class... Args>
+        explicit Input(Args&&... args) : source{std::forward<Args>(args)...} {}
+    };
+
+    // Declared before the reader, which reads from it until it is destroyed
+    std::unique_ptr<Input> input_;
+    std::unique_ptr<xmlTextReader, ReaderDeleter> reader_;
+    std::size_t window_size_;
+
+    static int read_input(void* context, char* buffer, int size);
+
+    /**
+     * Opens a file as input, resetting errors of earlier documents.
+     */
+    static std::unique_ptr<Input> open_file(const std::string& filename);
+
+    SvgStream(std::unique_ptr<Input> input, std::size_t window_size);
+
+ public:
+    /**
+     * Opens a file for streaming.
+     *
+     * @throws SvgLoadError If the file can't be opened.
+     */
+    explicit SvgStream(const std::string& filename,
+                       std::size_t window_size = kDefaultWindowSize);
+
+    /**
+     * Opens a file descriptor, like stdin, for streaming.
+     *
+     * The file descriptor is not closed. Reads the first bytes to detect
+     * compression.
+     *
+     * @param name Name of the input used in error messages.
+     * @throws SvgLoadError If reading fails or the reader can't be created.
+     */
+    static SvgStream from_fd(int fd, const std::string& name,
+                             std::size_t window_size = kDefaultWindowSize);
+
+    /**
+     * Reads the whole document, passing on partial copies of it.
+     *
+     * Can only be called once.
+     *
+     * @throws SvgLoadError If the document is malformed. Parts read before
+     *                      the error have already been passed on.
+     */
+    SvgStreamStats read(const TraverseFunction& traverse);
+};
+
+#endif  // SVG_CONVERTER_SVG_STREAM_H_
@@ -0,0 +1,49 @@
+#ifndef SVG_CONVERTER_THREAD_POOL_H_
+#define SVG_CONVERTER_THREAD_POOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/**
+ * Number of threads to use if the user did not specify any.
+ */
+inline unsigned default_thread_count() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/**
+ * Calls `func(index)` for every index in `[0, count)` using a pool of threads.
+ *
+ * Indices are handed out in increasing order to whichever thread is idle, so
+ * expensive and cheap items are balanced automatically. The calling thread
+ * takes part in the work, at most `num_threads - 1` additional threads are
+ * started. Blocks until all calls have returned.
+ *
+ * `func` must be safe to call concurrently and must not throw.
+ */
+template <class Func>
+void parallel_for(std::size_t count, unsigned num_threads, Func func) {
+    std::atomic<std::size_t> next_index{0};
+    auto worker = [&next_index, &func, count]() {
+        for (std::size_t index = next_index++; index < count;
+             index = next_index++) {
+            func(index);
+        }
+    };
+
+    std::size_t pool_size = std::min<std::size_t>(num_threads, count);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < pool_size; i++) {
+        threads.emplace_back(worker);
+    }
+
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+#endif  // SVG_CONVERTER_THREAD_POOL_H_
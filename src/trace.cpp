@@ -0,0 +1,240 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * A recorded begin or end of an event.
+ */
+struct TraceEvent {
+    /**
+     * Time since the clock's epoch. Unlike a time point, a duration leaves
+     * the event trivially constructible, so buffers can stay uninitialized.
+     */
+    std::chrono::steady_clock::duration time;
+
+    /**
+     * Name of a begin event, null for end events.
+     */
+    const char* name;
+    char id[kMaxTraceIdLength];
+    std::size_t id_length;
+};
+
+/**
+ * Ring buffer with the events of a single thread.
+ */
+class TraceBuffer {
+ private:
+    /**
+     * Left uninitialized, so that memory is only committed for the parts
+     * that were recorded into.
+     */
+    std::unique_ptr<TraceEvent[]> events_;
+    std::size_t capacity_;
+
+    /**
+     * Number of events recorded so far, including overwritten ones.
+     */
+    std::size_t recorded_ = 0;
+
+ public:
+    explicit TraceBuffer(std::size_t capacity)
+        : events_{new TraceEvent[capacity]}, capacity_{capacity} {}
+
+    TraceEvent& next() {
+        TraceEvent& event = events_[recorded_ % capacity_];
+        recorded_++;
+        return event;
+    }
+
+    /**
+     * Calls `func` for the retained events, from oldest to newest.
+     */
+    template <class Func>
+    void for_each(Func func) const {
+        std::size_t begin = recorded_ > capacity_ ? recorded_ - capacity_ : 0;
+        for (std::size_t i = begin; i < recorded_; i++) {
+            func(events_[i % capacity_]);
+        }
+    }
+};
+
+/**
+ * Buffers of all threads that recorded events since tracing was started.
+ */
+struct TraceState {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+
+    /**
+     * Buffers not used by any running thread. Worker threads are started
+     * anew for every parallel loop, so they take over the buffers of
+     * finished ones.
+     */
+    std::vector<TraceBuffer*> free_buffers;
+
+    std::size_t capacity = kDefaultTraceCapacity;
+    std::chrono::steady_clock::time_point start_time;
+
+    /**
+     * Incremented by every start, so threads notice that their buffer
+     * belongs to an earlier recording.
+     */
+    std::size_t generation = 0;
+};
+
+TraceState& trace_state() {
+    static TraceState state;
+    return state;
+}
+
+/**
+ * The buffer a thread records into, returned to the free buffers when the
+ * thread exits.
+ */
+struct ThreadBuffer {
+    TraceBuffer* buffer = nullptr;
+    std::size_t generation = 0;
+
+    ~ThreadBuffer() {
+        if (buffer == nullptr) {
+            return;
+        }
+
+        TraceState& state = trace_state();
+        std::lock_guard<std::mutex> lock{state.mutex};
+        if (generation == state.generation) {
+            state.free_buffers.push_back(buffer);
+        }
+    }
+};
+
+/**
+ * Buffer of the current thread, taking a free one or allocating a new one
+ * if necessary.
+ */
+TraceBuffer& thread_buffer() {
+    static thread_local ThreadBuffer current;
+
+    TraceState& state = trace_state();
+    // Starting happens before any recording, so the generation can't change
+    // while a thread records
+    if (current.buffer == nullptr || current.generation != state.generation) {
+        std::lock_guard<std::mutex> lock{state.mutex};
+        if (state.free_buffers.empty()) {
+            state.buffers.push_back(
+                std::make_unique<TraceBuffer>(state.capacity));
+            current.buffer = state.buffers.back().get();
+        } else {
+            current.buffer = state.free_buffers.back();
+            state.free_buffers.pop_back();
+        }
+
+        current.generation = state.generation;
+    }
+
+    return *current.buffer;
+}
+
+void trace_begin(const char* name) {
+    TraceEvent& event = thread_buffer().next();
+    event.time = std::chrono::steady_clock::now().time_since_epoch();
+    event.name = name;
+    event.id_length = 0;
+}
+
+void trace_end(const char* id, std::size_t id_length) {
+    TraceEvent& event = thread_buffer().next();
+    event.time = std::chrono::steady_clock::now().time_since_epoch();
+    event.name = nullptr;
+    event.id_length =
+        detail::utf8_prefix_length(id, id_length, kMaxTraceIdLength);
+    std::copy_n(id, event.id_length, event.id);
+}
+
+void start_tracing(std::size_t capacity) {
+    TraceState& state = trace_state();
+    {
+        std::lock_guard<std::mutex> lock{state.mutex};
+        state.buffers.clear();
+        state.free_buffers.clear();
+        state.capacity = std::max<std::size_t>(capacity, 1);
+        state.start_time = std::chrono::steady_clock::now();
+        state.generation++;
+    }
+
+    thread_buffer();
+    detail::tracing_flag().store(true);
+}
+
+void stop_tracing() { detail::tracing_flag().store(false); }
+
+/**
+ * Writes a string as the contents of a JSON string.
+ */
+void write_json_escaped(std::ostream& out, const char* data,
+                        std::size_t length) {
+    for (std::size_t i = 0; i < length; i++) {
+        char c = data[i];
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else {
+            out << c;
+        }
+    }
+}
+
+void write_trace_json(std::ostream& out) {
+    TraceState& state = trace_state();
+    std::lock_guard<std::mutex> lock{state.mutex};
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    char timestamp[32];
+    for (std::size_t thread = 0; thread < state.buffers.size(); thread++) {
+        // Names of the open events, to drop ends whose begin was overwritten
+        // and to label ends (which some viewers require)
+        std::vector<const char*> open_events;
+        state.buffers[thread]->for_each([&](const TraceEvent& event) {
+            if (event.name == nullptr && open_events.empty()) {
+                return;
+            }
+
+            std::chrono::duration<double, std::micro> time =
+                event.time - state.start_time.time_since_epoch();
+            std::snprintf(timestamp, sizeof(timestamp), "%.3f", time.count());
+            out << (first ? "" : ",") << "\n{\"ph\":\""
+                << (event.name != nullptr ? 'B' : 'E')
+                << "\",\"pid\":1,\"tid\":" << thread + 1
+                << ",\"ts\":" << timestamp << ",\"name\":\"";
+            first = false;
+            if (event.name != nullptr) {
+                out << event.name << '"';
+                open_events.push_back(event.name);
+            } else {
+                out << open_events.back() << '"';
+                open_events.pop_back();
+            }
+
+            if (event.id_length > 0) {
+                out << ",\"args\":{\"id\":\"";
+                write_json_escaped(out, event.id, event.id_length);
+                out << "\"}";
+            }
+
+            out << '}';
+        });
+    }
+
+    out << "\n]}\n";
+}
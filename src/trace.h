@@ -0,0 +1,186 @@
+#ifndef SVG_CONVERTER_TRACE_H_
+#define SVG_CONVERTER_TRACE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <ostream>
+
+#include <boost/range.hpp>
+
+// Set to 0 to compile out all counting, timing and tracing. Reports are
+// still written, but contain only zeros, and traces are empty.
+#ifndef SVG_CONVERTER_STATS
+#define SVG_CONVERTER_STATS 1
+#endif
+
+/**
+ * Default number of events kept per thread while tracing.
+ *
+ * Older events are overwritten once a thread recorded more.
+ */
+constexpr std::size_t kDefaultTraceCapacity = 1 << 18;
+
+/**
+ * Maximum length in bytes of an element id in a trace, longer ids are
+ * truncated at a character boundary.
+ */
+constexpr std::size_t kMaxTraceIdLength = 31;
+
+namespace detail {
+
+inline std::atomic<bool>& tracing_flag() {
+    static std::atomic<bool> flag{false};
+    return flag;
+}
+
+/**
+ * Length of the longest prefix of a UTF-8 string that is at most
+ * `max_length` bytes long and doesn't end within a character.
+ */
+template <class Iterator>
+std::size_t utf8_prefix_length(Iterator text, std::size_t length,
+                               std::size_t max_length) {
+    if (length <= max_length) {
+        return length;
+    }
+
+    // Back up to the first byte of the character that doesn't fit
+    std::size_t prefix_length = max_length;
+    while (prefix_length > 0 &&
+           (static_cast<unsigned char>(text[prefix_length]) & 0xc0) == 0x80) {
+        prefix_length--;
+    }
+
+    return prefix_length;
+}
+
+}  // namespace detail
+
+/**
+ * Whether events are currently being recorded.
+ */
+inline bool tracing() {
+#if SVG_CONVERTER_STATS
+    return detail::tracing_flag().load(std::memory_order_relaxed);
+#else
+    return false;
+#endif
+}
+
+/**
+ * Records the begin of an event on the current thread.
+ *
+ * @param name Name of the event, must have static storage duration.
+ */
+void trace_begin(const char* name);
+
+/**
+ * Records the end of the innermost event begun on the current thread.
+ *
+ * @param id Element id to attach to the event, if any. Copied.
+ */
+void trace_end(const char* id = nullptr, std::size_t id_length = 0);
+
+/**
+ * Records an event spanning its scope, if tracing.
+ */
+class TraceScope {
+ private:
+    bool active_;
+
+ public:
+    explicit TraceScope(const char* name) : active_{tracing()} {
+        if (active_) {
+            trace_begin(name);
+        }
+    }
+
+    ~TraceScope() {
+        if (active_) {
+            trace_end();
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+/**
+ * Records an event for an SVG element, if tracing.
+ *
+ * Begins when the element's context calls `begin`, ends with the context's
+ * destruction and is labeled with the element's id if it has one.
+ */
+class ElementTrace {
+ private:
+    bool active_ = false;
+    char id_[kMaxTraceIdLength];
+    std::size_t id_length_ = 0;
+
+ public:
+    ElementTrace() = default;
+
+    /**
+     * Copies don't record an event of their own.
+     */
+    ElementTrace(const ElementTrace& /*unused*/) {}
+
+    ElementTrace& operator=(const ElementTrace&) = delete;
+
+    ~ElementTrace() {
+        if (active_) {
+            trace_end(id_, id_length_);
+        }
+    }
+
+    /**
+     * @param element_name Must have static storage duration.
+     */
+    void begin(const char* element_name) {
+        active_ = tracing();
+        if (active_) {
+            trace_begin(element_name);
+        }
+    }
+
+    template <class Range>
+    void set_id(const Range& id) {
+        if (active_) {
+            id_length_ = detail::utf8_prefix_length(
+                boost::begin(id), boost::size(id), kMaxTraceIdLength);
+            std::copy_n(boost::begin(id), id_length_, id_);
+        }
+    }
+};
+
+/**
+ * Starts recording events on all threads.
+ *
+ * Each running thread records into a ring buffer of its own, which is
+ * allocated with its first event. Buffers are left uninitialized, so that
+ * allocating one doesn't touch its memory and only the parts that are
+ * recorded into take up space. A thread that exits hands its buffer on to
+ * the next one, so short-lived worker threads don't allocate again, and
+ * threads that don't overlap in time share a row in the trace.
+ *
+ * @param capacity Number of events kept per buffer.
+ */
+void start_tracing(std::size_t capacity = kDefaultTraceCapacity);
+
+/**
+ * Stops recording events.
+ */
+void stop_tracing();
+
+/**
+ * Writes the recorded events in the Chrome Trace Event format.
+ *
+ * Can be loaded in `chrome://tracing` or Perfetto. Events of which only the
+ * end remains in a ring buffer are left out, as are the ends of events begun
+ * while tracing was stopped. Must only be called after tracing was stopped
+ * and the recording threads finished.
+ */
+void write_trace_json(std::ostream& out);
+
+#endif  // SVG_CONVERTER_TRACE_H_
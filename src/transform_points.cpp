@@ -0,0 +1,242 @@
+#include "transform_points.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SVG_CONVERTER_HAVE_SSE2 1
+#endif
+
+// AVX2 code is compiled with a target attribute and only run on CPUs
+// supporting it, so the binary doesn't require AVX2
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SVG_CONVERTER_HAVE_AVX2 1
+#endif
+
+/**
+ * Shape of a transformation, from cheapest to most expensive to apply.
+ */
+enum class TransformShape { kIdentity, kTranslation, kUniformScale, kAffine };
+
+/**
+ * Coefficients of an affine transformation, mapping (x, y) to
+ * (a * x + c * y + e, b * x + d * y + f).
+ */
+struct AffineCoefficients {
+    double a, b, c, d, e, f;
+};
+
+TransformShape classify(const AffineCoefficients& m) {
+    if (m.b != 0 || m.c != 0 || m.a != m.d) {
+        return TransformShape::kAffine;
+    }
+
+    if (m.a != 1) {
+        return TransformShape::kUniformScale;
+    }
+
+    if (m.e != 0 || m.f != 0) {
+        return TransformShape::kTranslation;
+    }
+
+    return TransformShape::kIdentity;
+}
+
+void transform_points_scalar(TransformShape shape, const AffineCoefficients& m,
+                             double* points, std::size_t count) {
+    double* end = points + 2 * count;
+    switch (shape) {
+        case TransformShape::kIdentity:
+            break;
+        case TransformShape::kTranslation:
+            for (double* p = points; p != end; p += 2) {
+                p[0] = p[0] + m.e;
+                p[1] = p[1] + m.f;
+            }
+            break;
+        case TransformShape::kUniformScale:
+            for (double* p = points; p != end; p += 2) {
+                p[0] = m.a * p[0] + m.e;
+                p[1] = m.a * p[1] + m.f;
+            }
+            break;
+        case TransformShape::kAffine:
+            for (double* p = points; p != end; p += 2) {
+                double x = p[0];
+                double y = p[1];
+                p[0] = (m.a * x + m.c * y) + m.e;
+                p[1] = (m.b * x + m.d * y) + m.f;
+            }
+            break;
+    }
+}
+
+#ifdef SVG_CONVERTER_HAVE_SSE2
+/**
+ * Transforms one point per 128 bit register.
+ */
+void transform_points_sse2(TransformShape shape, const AffineCoefficients& m,
+                           double* points, std::size_t count) {
+    double* end = points + 2 * count;
+    const __m128d translation = _mm_set_pd(m.f, m.e);
+    switch (shape) {
+        case TransformShape::kIdentity:
+            break;
+        case TransformShape::kTranslation:
+            for (double* p = points; p != end; p += 2) {
+                _mm_storeu_pd(p, _mm_add_pd(_mm_loadu_pd(p), translation));
+            }
+            break;
+        case TransformShape::kUniformScale: {
+            const __m128d scale = _mm_set1_pd(m.a);
+            for (double* p = points; p != end; p += 2) {
+                __m128d scaled = _mm_mul_pd(scale, _mm_loadu_pd(p));
+                _mm_storeu_pd(p, _mm_add_pd(scaled, translation));
+            }
+            break;
+        }
+        case TransformShape::kAffine: {
+            const __m128d column_x = _mm_set_pd(m.b, m.a);
+            const __m128d column_y = _mm_set_pd(m.d, m.c);
+            for (double* p = points; p != end; p += 2) {
+                __m128d point = _mm_loadu_pd(p);
+                __m128d x = _mm_unpacklo_pd(point, point);
+                __m128d y = _mm_unpackhi_pd(point, point);
+                __m128d linear = _mm_add_pd(_mm_mul_pd(column_x, x),
+                                            _mm_mul_pd(column_y, y));
+                _mm_storeu_pd(p, _mm_add_pd(linear, translation));
+            }
+            break;
+        }
+    }
+}
+#endif
+
+#ifdef SVG_CONVERTER_HAVE_AVX2
+/**
+ * Transforms two points per 256 bit register.
+ *
+ * An odd last point is transformed in the lower half of the registers.
+ * Calling the SSE2 or scalar kernel for it instead would run non-VEX code
+ * with dirty upper halves, which stalls on many CPUs.
+ */
+__attribute__((target("avx2"))) void transform_points_avx2(
+    TransformShape shape, const AffineCoefficients& m, double* points,
+    std::size_t count) {
+    double* end = points + 2 * (count & ~std::size_t{1});
+    const bool odd = (count & 1) != 0;
+    const __m256d translation = _mm256_set_pd(m.f, m.e, m.f, m.e);
+    const __m128d translation_low = _mm256_castpd256_pd128(translation);
+    switch (shape) {
+        case TransformShape::kIdentity:
+            break;
+        case TransformShape::kTranslation:
+            for (double* p = points; p != end; p += 4) {
+                _mm256_storeu_pd(
+                    p, _mm256_add_pd(_mm256_loadu_pd(p), translation));
+            }
+
+            if (odd) {
+                _mm_storeu_pd(end,
+                              _mm_add_pd(_mm_loadu_pd(end), translation_low));
+            }
+            break;
+        case TransformShape::kUniformScale: {
+            const __m256d scale = _mm256_set1_pd(m.a);
+            for (double* p = points; p != end; p += 4) {
+                __m256d scaled = _mm256_mul_pd(scale, _mm256_loadu_pd(p));
+                _mm256_storeu_pd(p, _mm256_add_pd(scaled, translation));
+            }
+
+            if (odd) {
+                __m128d scaled = _mm_mul_pd(_mm256_castpd256_pd128(scale),
+                                            _mm_loadu_pd(end));
+                _mm_storeu_pd(end, _mm_add_pd(scaled, translation_low));
+            }
+            break;
+        }
+        case TransformShape::kAffine: {
+            const __m256d column_x = _mm256_set_pd(m.b, m.a, m.b, m.a);
+            const __m256d column_y = _mm256_set_pd(m.d, m.c, m.d, m.c);
+            for (double* p = points; p != end; p += 4) {
+                __m256d point = _mm256_loadu_pd(p);
+                __m256d x = _mm256_unpacklo_pd(point, point);
+                __m256d y = _mm256_unpackhi_pd(point, point);
+                __m256d linear = _mm256_add_pd(_mm256_mul_pd(column_x, x),
+                                               _mm256_mul_pd(column_y, y));
+                _mm256_storeu_pd(p, _mm256_add_pd(linear, translation));
+            }
+
+            if (odd) {
+                __m128d point = _mm_loadu_pd(end);
+                __m128d x = _mm_unpacklo_pd(point, point);
+                __m128d y = _mm_unpackhi_pd(point, point);
+                __m128d linear = _mm_add_pd(
+                    _mm_mul_pd(_mm256_castpd256_pd128(column_x), x),
+                    _mm_mul_pd(_mm256_castpd256_pd128(column_y), y));
+                _mm_storeu_pd(end, _mm_add_pd(linear, translation_low));
+            }
+            break;
+        }
+    }
+}
+#endif
+
+TransformKernel detect_transform_kernel() {
+#ifdef SVG_CONVERTER_HAVE_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return TransformKernel::kAvx2;
+    }
+#endif
+#ifdef SVG_CONVERTER_HAVE_SSE2
+    return TransformKernel::kSse2;
+#else
+    return TransformKernel::kScalar;
+#endif
+}
+
+TransformKernel transform_kernel() {
+    static const TransformKernel kernel = detect_transform_kernel();
+    return kernel;
+}
+
+const char* transform_kernel_name(TransformKernel kernel) {
+    switch (kernel) {
+        case TransformKernel::kScalar:
+            return "scalar";
+        case TransformKernel::kSse2:
+            return "SSE2";
+        case TransformKernel::kAvx2:
+            return "AVX2";
+    }
+
+    return "unknown";
+}
+
+void transform_points(const Transform& transform, Vector* points,
+                      std::size_t count) {
+    const auto& matrix = transform.matrix();
+    const AffineCoefficients m{matrix(0, 0), matrix(1, 0), matrix(0, 1),
+                               matrix(1, 1), matrix(0, 2), matrix(1, 2)};
+    TransformShape shape = classify(m);
+    if (shape == TransformShape::kIdentity || count == 0) {
+        return;
+    }
+
+    // Vectors are two packed doubles, so the points form one double array
+    double* data = points->data();
+    switch (transform_kernel()) {
+#ifdef SVG_CONVERTER_HAVE_AVX2
+        case TransformKernel::kAvx2:
+            transform_points_avx2(shape, m, data, count);
+            return;
+#endif
+#ifdef SVG_CONVERTER_HAVE_SSE2
+        case TransformKernel::kSse2:
+            transform_points_sse2(shape, m, data, count);
+            return;
+#endif
+        default:
+            transform_points_scalar(shape, m, data, count);
+            return;
+    }
+}
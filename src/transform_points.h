@@ -0,0 +1,35 @@
+#ifndef SVG_CONVERTER_TRANSFORM_POINTS_H_
+#define SVG_CONVERTER_TRANSFORM_POINTS_H_
+
+#include <cstddef>
+
+#include "math_defs.h"
+
+/**
+ * Kernel used by `transform_points`, selected once by the features of the
+ * CPU.
+ */
+enum class TransformKernel { kScalar, kSse2, kAvx2 };
+
+/**
+ * Kernel `transform_points` uses on this CPU.
+ */
+TransformKernel transform_kernel();
+
+/**
+ * Name of a kernel for log messages.
+ */
+const char* transform_kernel_name(TransformKernel kernel);
+
+/**
+ * Applies an affine transformation to an array of points in place.
+ *
+ * Identities, pure translations and uniform scales with a translation are
+ * detected and take shortcuts. All kernels compute the same products and
+ * sums in the same order without fused multiply-adds, so the results don't
+ * depend on the CPU.
+ */
+void transform_points(const Transform& transform, Vector* points,
+                      std::size_t count);
+
+#endif  // SVG_CONVERTER_TRANSFORM_POINTS_H_
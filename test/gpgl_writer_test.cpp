@@ -0,0 +1,61 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "output_sink.h"
+#include "parsing/gpgl_exporter.h"
+
+/**
+ * Writes commands with a simplifying writer and compares the output.
+ *
+ * @return False if the output differs, which is reported to stderr.
+ */
+template <class Commands>
+bool check_simplified(const char* name, Commands commands,
+                      const std::string& expected) {
+    std::string output;
+    OutputSink sink{[&output](const char* data, std::size_t size) {
+        output.append(data, size);
+    }};
+    GpglWriter writer{sink, 0.5};
+    commands(writer);
+    writer.end_shape();
+    sink.flush();
+
+    if (output != expected) {
+        std::cerr << name << ": expected \"" << expected << "\", got \""
+                  << output << "\"\n";
+        return false;
+    }
+
+    return true;
+}
+
+int main() {
+    bool success = true;
+
+    // A stroke back to the start of a run has to be kept, even though every
+    // point of the run lies on the (zero length) line to it
+    success = check_simplified("out and back",
+                               [](GpglWriter& writer) {
+                                   writer.move_to(Vector{0, 0});
+                                   writer.draw_to(Vector{100, 0});
+                                   writer.draw_to(Vector{0, 0});
+                               },
+                               "M 0,0\x03"
+                               "D 100,0\x03"
+                               "D 0,0\x03") &&
+              success;
+
+    success = check_simplified("collinear",
+                               [](GpglWriter& writer) {
+                                   writer.move_to(Vector{0, 0});
+                                   writer.draw_to(Vector{50, 0});
+                                   writer.draw_to(Vector{100, 0});
+                               },
+                               "M 0,0\x03"
+                               "D 100,0\x03") &&
+              success;
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}